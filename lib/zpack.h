@@ -37,6 +37,7 @@ typedef zpack_u8 zpack_bool;
 #define ZPACK_DATA_SIGNATURE   0x144b505a // ZPK\x14
 #define ZPACK_CDR_SIGNATURE    0x134b505a // ZPK\x13
 #define ZPACK_EOCDR_SIGNATURE  0x124b505a // ZPK\x12
+#define ZPACK_SIDECAR_SIGNATURE 0x114b505a // ZPK\x11
 
 #define ZPACK_SIGNATURE_SIZE 4
 #define ZPACK_HEADER_SIZE 6
@@ -44,6 +45,8 @@ typedef zpack_u8 zpack_bool;
 #define ZPACK_FILE_ENTRY_FIXED_SIZE 35 // size of fixed fields in file entry
 #define ZPACK_EOCDR_SIZE 12
 #define ZPACK_MINIMUM_ARCHIVE_SIZE (ZPACK_HEADER_SIZE + ZPACK_SIGNATURE_SIZE + ZPACK_CDR_HEADER_SIZE + ZPACK_EOCDR_SIZE)
+#define ZPACK_SIDECAR_HEADER_SIZE 72 // keeps the arrays that follow it 8 byte aligned
+#define ZPACK_SIDECAR_VERSION 1
 
 #define ZPACK_MAX_FILENAME_LENGTH 65535
 
@@ -79,14 +82,178 @@ typedef struct zpack_file_entry_s
     
 } zpack_file_entry;
 
+/**
+ * @ingroup index
+ */
+typedef struct zpack_file_index_slot_s
+{
+    zpack_u64 hash;  //!< Hash of the filename
+    zpack_u64 entry; //!< Index of the file entry + 1, 0 if the slot is empty
+
+} zpack_file_index_slot;
+
+/**
+ * @ingroup index
+ */
+typedef struct zpack_file_index_s
+{
+    zpack_file_index_slot* slots;
+    zpack_u64 capacity; //!< Number of slots (always a power of 2)
+    zpack_u64 count;    //!< Number of occupied slots
+
+} zpack_file_index;
+
+/**
+ * @ingroup dir_index
+ */
+typedef struct zpack_dir_node_s
+{
+    zpack_u64 parent;      //!< Index of the parent directory (the root directory is its own parent)
+    zpack_u64 name_offset; //!< Offset of the directory's name in the index's name pool
+    zpack_u64 name_length; //!< Length of the directory's name
+    zpack_u64 first_child; //!< Index of the first subdirectory. The subdirectories of a directory are stored next to each other
+    zpack_u64 child_count; //!< Number of subdirectories
+    zpack_u64 first_file;  //!< Position of the directory's first file in the index's file list
+    zpack_u64 file_count;  //!< Number of files in the directory (not including subdirectories)
+
+} zpack_dir_node;
+
+/**
+ * @ingroup dir_index
+ */
+typedef struct zpack_dir_index_s
+{
+    zpack_dir_node* dirs; //!< Directories in breadth first order. dirs[0] is the root directory
+    zpack_u64 dir_count;
+    zpack_u64* files;     //!< Positions of the file entries in their list, grouped by directory
+    zpack_u64 file_count;
+    char* names;          //!< Directory names, each one is stored once and null terminated
+    size_t names_size;
+
+    // (parent, name) lookup table
+    zpack_file_index_slot* slots;
+    zpack_u64 capacity;
+
+} zpack_dir_index;
+
+/**
+ * @ingroup entry_table
+ */
+typedef struct zpack_entry_table_s
+{
+    zpack_u64 count;
+    zpack_u64* offsets;
+    zpack_u64* comp_sizes;
+    zpack_u64* uncomp_sizes;
+    zpack_u64* hashes;
+    zpack_u32* name_offsets; //!< Offset of each filename in the string pool
+    zpack_u8* comp_methods;
+    char* names;             //!< String pool holding the null terminated filenames
+    size_t names_size;
+    zpack_file_index index;  //!< Filename lookup index (see @ref zpack_find_table_entry)
+    zpack_bool shared;       // the arrays and the index point into a mapped sidecar index
+
+} zpack_entry_table;
+
+/**
+ * @ingroup reader
+ * Default number of decompression contexts that a reader keeps for each compression method.
+ */
+#define ZPACK_DEFAULT_DCTX_POOL_SIZE 16
+
+/**
+ * @ingroup reader
+ * Default size of the read used by @ref ZPACK_READER_TAIL_READ.
+ */
+#define ZPACK_DEFAULT_TAIL_READ_SIZE (1 << 18) // 256kb
+
+/**
+ * @ingroup reader
+ * Default block size of the cache used by readers opened with @ref zpack_init_reader_fetch.
+ */
+#define ZPACK_DEFAULT_FETCH_BLOCK_SIZE (1 << 18) // 256kb
+
+/**
+ * @ingroup reader
+ * Default memory budget of the block cache used by readers opened with @ref zpack_init_reader_fetch.
+ */
+#define ZPACK_DEFAULT_FETCH_CACHE_SIZE (1 << 25) // 32mb
+
+/**
+ * @ingroup reader
+ * Fetches a range of the archive for readers opened with @ref zpack_init_reader_fetch. May be
+ * called from multiple threads at once when the reader is used concurrently.
+ * @param offset Offset of the range.
+ * @param buffer The buffer to fill.
+ * @param size Size of the range. The whole range must be fetched.
+ * @param user_data User data passed to zpack_init_reader_fetch.
+ * @return ZPACK_OK, or an error code (usually @ref ZPACK_ERROR_READ_FAILED) that is returned by
+ *         the function that requested the data.
+ */
+typedef int (*zpack_fetch_callback)(zpack_u64 offset, zpack_u8* buffer, size_t size, void* user_data);
+
+/**
+ * @ingroup reader
+ */
+enum zpack_reader_flags //! Reader options. These must be set in reader->flags before initializing the reader.
+{
+    ZPACK_READER_SKIP_FILE_ENTRIES = 1 << 0, //!< Don't read the file entries when opening the archive. file_entries and file_index will be left empty; use a @ref zpack_cdr_iterator to walk the entries instead.
+    ZPACK_READER_POSITIONAL_IO     = 1 << 1, //!< Read files using positional I/O (pread/ReadFile with an offset) instead of fseek + fread. The file stream's position is never used after the archive has been opened, which makes file reading functions thread safe (see @ref reader).
+    ZPACK_READER_DIRECTORY_INDEX   = 1 << 2, //!< Build a directory index (reader->dir_index) when opening the archive, which is needed for @ref zpack_list_dir.
+    ZPACK_READER_ASYNC_IO          = 1 << 3, //!< Use io_uring on Linux to keep multiple reads in flight in @ref zpack_read_files. Ignored when reading from a buffer, and falls back to the regular reads if io_uring isn't supported by the build or the kernel.
+    ZPACK_READER_ENTRY_TABLE       = 1 << 4, //!< Build a compact entry table (reader->entry_table) when opening the archive. Combine with @ref ZPACK_READER_SKIP_FILE_ENTRIES to keep only the table in memory. If reader->sidecar_path is set, the table is mapped from the sidecar index instead when it is valid (see @ref sidecar).
+    ZPACK_READER_TAIL_READ         = 1 << 5  //!< Read the end of the archive (reader->tail_read_size bytes) in a single read when opening it, instead of reading each section separately. The CDR is parsed from that read if it fits in it, otherwise the rest of it is fetched with one more read. The header takes a separate read unless the whole archive fits. Ignored when reading from a buffer
+
+};
+
+/**
+ * @ingroup reader
+ */
+enum zpack_verify_policy //! When to verify the hash of files read by @ref zpack_read_file and @ref zpack_read_file_stream
+{
+    ZPACK_VERIFY_ALWAYS,    //!< Verify every read (default)
+    ZPACK_VERIFY_NEVER,     //!< Never verify. Only use this for trusted archives
+    ZPACK_VERIFY_ONCE,      //!< Verify the first successful read of each file entry and skip verification afterwards
+    ZPACK_VERIFY_BACKGROUND //!< Don't verify reads. Instead, files that have been read are verified by a background thread. Once a file has been found to be corrupted, further reads of it return @ref ZPACK_ERROR_FILE_HASH_MISMATCH. Only available for readers that read from a buffer, a memory mapped file or use @ref ZPACK_READER_POSITIONAL_IO; other readers fall back to @ref ZPACK_VERIFY_ONCE
+
+};
+
+/**
+ * @ingroup reader
+ * A file to be read by @ref zpack_read_files
+ */
+typedef struct zpack_read_request_s
+{
+    zpack_file_entry* entry;
+    zpack_u8* buffer; //!< The output buffer
+    size_t max_size;  //!< Size of the output buffer
+    int result;       //!< Set to the return code of the file's read (see @ref zpack_result)
+
+} zpack_read_request;
+
+/**
+ * @ingroup reader
+ * Grow-only buffer that holds compressed data between reads (see @ref zpack_read_file_scratch).
+ */
+typedef struct zpack_scratch_s
+{
+    zpack_u8* buffer;
+    size_t capacity;
+
+} zpack_scratch;
+
 /**
  * @ingroup reader
  */
 typedef struct zpack_reader_s
 {
+    zpack_u32 flags; //!< Reader options (see @ref zpack_reader_flags)
     zpack_u16 version;
     zpack_file_entry* file_entries;
     zpack_u64 file_count;
+    zpack_file_index file_index;
+    zpack_dir_index dir_index; //!< Directory index, only built with @ref ZPACK_READER_DIRECTORY_INDEX
+    zpack_entry_table entry_table; //!< Structure of arrays entry table, only built with @ref ZPACK_READER_ENTRY_TABLE
     zpack_u64 comp_size;
     zpack_u64 uncomp_size;
     size_t file_size;
@@ -97,6 +264,13 @@ typedef struct zpack_reader_s
     // LZ4
     void* lz4f_dctx;
 
+    // decompression context pools, used by zpack_read_file when no context is given
+    void* volatile* zstd_dctx_pool;
+    void* volatile* lz4f_dctx_pool;
+    size_t dctx_pool_size; //!< Number of pooled contexts per compression method. Can be set before initializing the reader, defaults to @ref ZPACK_DEFAULT_DCTX_POOL_SIZE
+
+    int parse_thread_count; //!< Number of threads used to parse the CDR and build the file index when opening the archive, including the calling thread. Must be set before initializing the reader; values less than 2 parse it on the calling thread, and at most 256 threads are used. Builds without thread support always use 1 thread
+
     size_t last_return; // last compression library return value
 
     // offsets
@@ -105,10 +279,62 @@ typedef struct zpack_reader_s
 
     zpack_u8* buffer;
     zpack_bool buffer_shared;
+    zpack_bool buffer_mapped;
     FILE* file;
 
+    zpack_scratch scratch; // compressed data buffer reused by zpack_read_file
+
+    zpack_u32 verify_policy; //!< Hash verification policy (see @ref zpack_verify_policy). Must be set before initializing the reader to use ZPACK_VERIFY_ONCE or ZPACK_VERIFY_BACKGROUND
+    volatile zpack_u32* verified_entries;  // bitmap of entries that have been verified
+    volatile zpack_u32* corrupted_entries; // bitmap of entries that failed background verification
+    void* verifier; // background verification thread
+
+    void* volatile async_io; // io_uring instance, only set up with ZPACK_READER_ASYNC_IO
+    void* prefetcher; // background prefetch thread
+
+    size_t cache_budget; //!< Memory budget in bytes of the decompressed file cache used by @ref zpack_read_file_cached. Must be set before initializing the reader, 0 disables the cache
+    void* cache;
+
+    size_t tail_read_size; //!< Size of the read used by @ref ZPACK_READER_TAIL_READ. Can be set before initializing the reader, defaults to @ref ZPACK_DEFAULT_TAIL_READ_SIZE
+    zpack_u8* cdr_buffer; // CDR fetched by the tail read, only kept while the archive is being opened
+
+    const char* sidecar_path; //!< Path of the sidecar index used with @ref ZPACK_READER_ENTRY_TABLE. Must be set before initializing the reader, the string is not copied
+    zpack_u8* sidecar; // mapped sidecar index
+    size_t sidecar_size;
+
+    zpack_fetch_callback fetch; // set by zpack_init_reader_fetch
+    void* fetch_user_data;
+    size_t fetch_block_size; //!< Block size of the cache used with @ref zpack_init_reader_fetch. Can be set before initializing the reader, defaults to @ref ZPACK_DEFAULT_FETCH_BLOCK_SIZE
+    size_t fetch_cache_size; //!< Memory budget in bytes of the cache used with @ref zpack_init_reader_fetch. Can be set before initializing the reader, defaults to @ref ZPACK_DEFAULT_FETCH_CACHE_SIZE
+    void* fetch_cache;
+
+    void* shared; // data shared with clones of the reader (see zpack_clone_reader)
+
 } zpack_reader;
 
+/**
+ * @ingroup cdr_iterator
+ */
+typedef struct zpack_cdr_iterator_s
+{
+    zpack_reader* reader;
+    zpack_u64 count; //!< Number of file entries in the archive
+    zpack_u64 index; //!< Index of the next entry
+
+    zpack_u64 offset;    // offset of the next block data to be read into the window
+    zpack_u64 size_left; // block data left to be parsed
+
+    zpack_u8* window;
+    size_t window_size;
+    size_t window_pos;
+    size_t window_len;
+    zpack_bool window_owned;
+
+    char* filename; // filename of the current entry
+    size_t filename_capacity;
+
+} zpack_cdr_iterator;
+
 /**
  * @ingroup writer
  */
@@ -148,6 +374,7 @@ typedef struct zpack_writer_s
     zpack_file_entry* file_entries;
     zpack_u64 fe_capacity;
     zpack_u64 file_count;
+    zpack_file_index file_index;
 
     // zstd
     void* zstd_cctx;
@@ -180,9 +407,41 @@ typedef struct zpack_stream_s
 
     // xxHash
     void* xxh3_state; 
+    zpack_bool verify; // whether the current file's hash is being verified (depends on the reader's verify_policy)
 
 } zpack_stream;
 
+/**
+ * @ingroup stream
+ * Pull-style stream for reading a single file (see @ref zpack_entry_stream_open). Must be zeroed
+ * before it's opened for the first time.
+ */
+typedef struct zpack_entry_stream_s
+{
+    zpack_reader* reader;
+    zpack_file_entry* entry;
+    void* dctx;
+
+    // context created by the stream when none is given, kept across reopens of the same method
+    void* own_dctx;
+    zpack_compression_method own_dctx_method;
+
+    // ring buffer holding compressed data that hasn't been decompressed yet (file readers only)
+    zpack_u8* buffer;
+    size_t capacity; //!< Size of the ring buffer. Can be set before the stream is opened for the first time, defaults to zpack_get_dstream_in_size(ZPACK_COMPRESSION_NONE)
+    size_t head;
+    size_t size;
+
+    zpack_u64 total_in;  //!< Compressed bytes read from the archive
+    zpack_u64 total_out; //!< Bytes written to the output
+    zpack_bool done;     //!< Set once the whole file has been read
+
+    // xxHash
+    void* xxh3_state;
+    zpack_bool verify;
+
+} zpack_entry_stream;
+
 /**
  * @ingroup common
  */
@@ -213,7 +472,8 @@ enum zpack_result //! Return codes
     ZPACK_ERROR_STREAM_INVALID,       //!< Invalid stream
     ZPACK_ERROR_HASH_FAILED,          //!< Failed to generate hash for the data provided
 	ZPACK_ERROR_FILENAME_TOO_LONG,    //!< Filename length exceeds limit (65535 characters)
-    ZPACK_ERROR_NOT_AVAILABLE         //!< Feature not available in this build of ZPack (compression method disabled, etc.)
+    ZPACK_ERROR_NOT_AVAILABLE,        //!< Feature not available in this build of ZPack (compression method disabled, etc.)
+    ZPACK_ERROR_MAP_FAILED            //!< Failed to memory map file
 
 };
 
@@ -281,8 +541,8 @@ ZPACK_EXPORT int zpack_read_eocdr(FILE* fp, zpack_u64 eocdr_offset, zpack_u64* c
 ZPACK_EXPORT int zpack_read_cdr_header_memory(const zpack_u8* buffer, zpack_u64* count, zpack_u64* block_size);
 
 /**
- * Read a single file entry from memory. Note that this function is used automatically by both
- * zpack_read_cdr_memory and zpack_read_cdr.
+ * Read a single file entry from memory. The filename will be allocated separately and must be
+ * freed by the caller.
  * @param buffer The buffer to read from.
  * @param size_left The size remaining of the buffer containing the block. Will be checked against
                     and subtracted by the entry size.
@@ -294,7 +554,9 @@ ZPACK_EXPORT int zpack_read_file_entry_memory(const zpack_u8* buffer, zpack_u64*
 
 /**
  * Read all file entries from memory. Note that this function is used automatically by both
- * zpack_read_cdr_memory and zpack_read_cdr.
+ * zpack_read_cdr_memory and zpack_read_cdr.\n
+ * The filenames are stored in a single string arena placed right after the entries, in the same
+ * allocation. Only *entries needs to be freed; the filenames must not be freed individually.
  * @param buffer The buffer to read from.
  * @param entries The file entries.
  * @param header_count Expected number of file entries (from the header)
@@ -332,12 +594,76 @@ ZPACK_EXPORT int zpack_read_cdr(FILE* fp, zpack_u64 cdr_offset, zpack_file_entry
 
 /** @} */ // lowlevel_read
 
+/** @defgroup cdr_iterator CDR Iterator
+ *  Walks the central directory record one entry at a time, reading it from the archive in fixed
+ *  size windows instead of loading the entire block and building a file entry list. Useful for
+ *  listing, filtering or looking up a few entries with bounded memory usage; combine with
+ *  @ref ZPACK_READER_SKIP_FILE_ENTRIES to skip loading the file entries entirely.\n
+ *  Thread safety: Not thread safe. When the reader reads from a file, the iterator uses the
+ *  reader's file stream, so other reading operations can't be run at the same time.
+ *  @{
+ */
+
+/**
+ * Minimum window size of a CDR iterator (enough to hold the largest possible file entry).
+ */
+#define ZPACK_CDR_ITERATOR_MIN_WINDOW_SIZE (ZPACK_FILE_ENTRY_FIXED_SIZE + ZPACK_MAX_FILENAME_LENGTH)
+
+/**
+ * Default window size of a CDR iterator.
+ */
+#define ZPACK_CDR_ITERATOR_DEFAULT_WINDOW_SIZE (1 << 17) // 128kb
+
+/**
+ * Initializes a CDR iterator for an opened archive.
+ * @param iterator The iterator.
+ * @param reader The reader.
+ * @param window_size Size of the window used when reading from a file. Pass 0 to use
+                      @ref ZPACK_CDR_ITERATOR_DEFAULT_WINDOW_SIZE. Sizes smaller than
+                      @ref ZPACK_CDR_ITERATOR_MIN_WINDOW_SIZE will be raised to it. Memory readers
+                      don't use a window.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_init_cdr_iterator(zpack_cdr_iterator* iterator, zpack_reader* reader, size_t window_size);
+
+/**
+ * Reads the next file entry. The entry's filename is owned by the iterator and is only valid until
+ * the next call to this function.
+ * @param iterator The iterator.
+ * @param entry The file entry.
+ * @return A return code (see @ref zpack_result). Returns ZPACK_ERROR_FILE_NOT_FOUND if there
+           are no entries left.
+ * @see ZPACK_CDR_ITERATOR_DONE
+ */
+ZPACK_EXPORT int zpack_next_cdr_entry(zpack_cdr_iterator* iterator, zpack_file_entry* entry);
+
+/**
+ * Checks if all entries have been read by the iterator.
+ */
+#define ZPACK_CDR_ITERATOR_DONE(iterator) ((iterator)->index == (iterator)->count)
+
+/**
+ * Closes the iterator, releasing all resources previously occupied by it.
+ * @param iterator The iterator.
+ */
+ZPACK_EXPORT void zpack_close_cdr_iterator(zpack_cdr_iterator* iterator);
+
+/** @} */ // cdr_iterator
+
 /** @defgroup reader Reader
  *  The archive reader.\n
  *  Thread safety: <b>Not guaranteed.</b>\n
- *  When reading from a buffer, all file reading functions are guaranteed to be thread safe,
- *  provided that you use a different decompression context for each thread.\n
- *  When reading from a file, thread safety is not guaranteed due to separate fseek/fread operations.
+ *  When reading from a buffer or a memory mapped file, all file reading functions are guaranteed
+ *  to be thread safe, provided that you use a different decompression context for each thread.
+ *  @ref zpack_read_file can also be called with a NULL context from multiple threads, in which case
+ *  each call borrows a context from the reader's lock-free pool (builds without atomics have no pool
+ *  and create a temporary context for each call instead).\n
+ *  When reading from a file, thread safety is not guaranteed due to separate fseek/fread operations,
+ *  unless the reader was opened with @ref ZPACK_READER_POSITIONAL_IO, in which case the same rules
+ *  as reading from a buffer apply.\n
+ *  Note that last_return is shared by all threads, during concurrent reads it holds the value from
+ *  whichever call stored it last. On platforms without atomics, it's only updated by readers that
+ *  can't be read concurrently.
  *  @{
  */
 
@@ -370,18 +696,199 @@ ZPACK_EXPORT int zpack_read_archive(zpack_reader* reader);
 ZPACK_EXPORT int zpack_read_raw_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size);
 
 /**
- * Read and decompress the data of a file.
+ * Read and decompress the data of a file.\n
+ * When reading from a file, the compressed data is held in a scratch buffer (see
+ * @ref zpack_read_file_scratch), unless the output buffer is at least
+ * @ref zpack_get_in_place_size bytes large. The compressed data is then read into the end of the
+ * output buffer and decompressed in place.
  * @param reader The reader.
  * @param entry The file entry.
  * @param buffer The output buffer.
  * @param max_size Maximum number of bytes to read from.
  * @param dctx The decompression context to be used. The context's compression library must
-               match the file's compression method. You can pass NULL to use the reader's
-               built-in decompression contexts.
+               match the file's compression method. You can pass NULL to borrow a context from
+               the reader's pool for the duration of the call. If all pooled contexts are in use,
+               or the build has no atomics, a temporary context is created.
  * @return A return code (see @ref zpack_result)
+ * @see zpack_verify_policy
  */
 ZPACK_EXPORT int zpack_read_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size, void* dctx);
 
+/**
+ * Gets the output buffer size that allows a file to be decompressed in place (see
+ * @ref zpack_read_file). This is the uncompressed size plus the safety margin documented by the
+ * compression library.
+ * @param entry The file entry.
+ * @return The buffer size, or 0 if the file's compression method can't be decompressed in place.
+ *         zstd files can only be decompressed in place with zstd 1.5.4 or newer, both at compile
+ *         time and at runtime.
+ */
+ZPACK_EXPORT size_t zpack_get_in_place_size(zpack_file_entry* entry);
+
+/**
+ * Read and decompress the data of a file, using a caller-supplied scratch buffer to hold the
+ * compressed data when reading from a file. The scratch buffer is grown as needed and can be
+ * reused across calls; free it with @ref zpack_free_scratch.\n
+ * zpack_read_file uses the reader's own scratch buffer, except when the reader was opened with
+ * @ref ZPACK_READER_POSITIONAL_IO, in which case a temporary buffer is allocated for every call.
+ * Use this function with one scratch buffer per thread to avoid that.
+ * @param reader The reader.
+ * @param entry The file entry.
+ * @param buffer The output buffer.
+ * @param max_size Maximum number of bytes to read from.
+ * @param dctx The decompression context to be used (see @ref zpack_read_file)
+ * @param scratch The scratch buffer. Must be zero-initialized before its first use.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_read_file_scratch(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size,
+                                         void* dctx, zpack_scratch* scratch);
+
+/**
+ * Maximum gap between two files that @ref zpack_read_files will read over to merge their reads.
+ */
+#define ZPACK_READ_FILES_MAX_GAP (1 << 16) // 64kb
+
+/**
+ * Maximum size of a single merged read issued by @ref zpack_read_files. Larger files are read by themselves.
+ */
+#define ZPACK_READ_FILES_MAX_RANGE (1 << 23) // 8mb
+
+/**
+ * Maximum number of reads kept in flight by @ref zpack_read_files when using @ref ZPACK_READER_ASYNC_IO.
+ */
+#define ZPACK_ASYNC_IO_QUEUE_DEPTH 32
+
+/**
+ * Maximum amount of data being read at once by @ref zpack_read_files when using @ref ZPACK_READER_ASYNC_IO.
+ * A single range that is larger than this is still read on its own.
+ */
+#define ZPACK_ASYNC_IO_MAX_IN_FLIGHT (1 << 26) // 64mb
+
+/**
+ * Read and decompress multiple files. The files are read in the order that they are stored in
+ * the archive, and files that are close to each other are read using a single sequential read
+ * (see @ref ZPACK_READ_FILES_MAX_GAP and @ref ZPACK_READ_FILES_MAX_RANGE).\n
+ * With @ref ZPACK_READER_ASYNC_IO, up to @ref ZPACK_ASYNC_IO_QUEUE_DEPTH of these reads are submitted
+ * at once and each file is decompressed as soon as its read completes. If another thread is using
+ * the reader's io_uring instance, the regular reads are used instead.\n
+ * Decompression contexts are borrowed from the reader's pool.
+ * @param reader The reader.
+ * @param requests The files to read. Each request's result will be set.
+ * @param count Number of requests.
+ * @return A return code (see @ref zpack_result). If any of the files failed to be read, the
+ *         result of the first failed request is returned.
+ */
+ZPACK_EXPORT int zpack_read_files(zpack_reader* reader, zpack_read_request* requests, size_t count);
+
+/**
+ * @ingroup reader
+ * Called by @ref zpack_read_files_parallel each time a file has been read.
+ * @param request The request, with its result set.
+ * @param user_data User data passed to zpack_read_files_parallel.
+ */
+typedef void (*zpack_read_callback)(zpack_read_request* request, void* user_data);
+
+/**
+ * Read and decompress multiple files using multiple threads. The calling thread takes part in
+ * the work and the function returns once every file has been read.\n
+ * Each worker thread has its own decompression contexts and scratch buffer, and reads the
+ * archive using positional I/O, regardless of @ref ZPACK_READER_POSITIONAL_IO. On platforms
+ * without positional I/O, files are read from the file stream on the calling thread only.\n
+ * The reader itself isn't modified, so it can be used by other threads at the same time under
+ * the same rules as the other reading functions (see @ref reader).\n
+ * Files are handed to the workers in the order they are stored in the archive.
+ * @param reader The reader.
+ * @param requests The files to read. Each request's result will be set.
+ * @param count Number of requests.
+ * @param thread_count Number of threads to use, including the calling thread. Values less than 1
+ *                     are treated as 1. Builds without thread support always use 1 thread.
+ * @param callback Function to call from the worker thread after each file has been read (can be NULL).
+ * @param user_data User data passed to the callback.
+ * @return A return code (see @ref zpack_result). If any of the files failed to be read, the
+ *         result of the first failed request is returned.
+ */
+ZPACK_EXPORT int zpack_read_files_parallel(zpack_reader* reader, zpack_read_request* requests, size_t count,
+                                           int thread_count, zpack_read_callback callback, void* user_data);
+
+/**
+ * Read and decompress a file through the reader's decompressed file cache. Cached files are kept
+ * in a least recently used list and evicted once the cache goes over reader->cache_budget.\n
+ * The returned buffer is reference counted and can be shared by multiple callers; it stays
+ * valid until it's released with @ref zpack_release_cached_file, even if the file is evicted in
+ * the meantime. Every buffer must be released before the reader is closed.\n
+ * Files larger than the budget, or every file if the cache is disabled, are read into a buffer
+ * of their own that is freed once released.\n
+ * Cache hits are thread safe. Misses call @ref zpack_read_file and follow its rules.
+ * @param reader The reader.
+ * @param entry The file entry. Files are identified by the address of their entry.
+ * @param data Set to the decompressed file, which is entry->uncomp_size bytes long.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_read_file_cached(zpack_reader* reader, zpack_file_entry* entry, const zpack_u8** data);
+
+/**
+ * Releases a buffer returned by @ref zpack_read_file_cached.
+ * @param reader The reader.
+ * @param data The buffer.
+ */
+ZPACK_EXPORT void zpack_release_cached_file(zpack_reader* reader, const zpack_u8* data);
+
+/**
+ * Tells the system that files are going to be read soon, so that their data can be loaded into
+ * the page cache ahead of time. Uses posix_fadvise for file readers and madvise for memory mapped
+ * files where available; this is a no-op for archives that are loaded in memory.\n
+ * Optionally, the data can also be read by a background thread, which works on every platform
+ * and doesn't depend on the kernel following the hint. Starting a new background prefetch cancels
+ * the previous one, and the thread is stopped when the reader is closed. It doesn't use the file
+ * stream's position, so the reader can still be used while it runs.
+ * @param reader The reader.
+ * @param entries The files to prefetch.
+ * @param count Number of files.
+ * @param background Whether to also read the data on a background thread. Ignored in builds
+ *                   without thread support.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_prefetch(zpack_reader* reader, zpack_file_entry** entries, size_t count, zpack_bool background);
+
+/**
+ * Tells the system that files are not going to be read anymore, so that their data can be
+ * dropped from the page cache (POSIX_FADV_DONTNEED/MADV_DONTNEED). This is the opposite of
+ * @ref zpack_prefetch, and a no-op where the hints are not available.
+ * @param reader The reader.
+ * @param entries The files to evict.
+ * @param count Number of files.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_evict(zpack_reader* reader, zpack_file_entry** entries, size_t count);
+
+/**
+ * Wait until the background verification thread has verified every file read so far.
+ * Does nothing unless the reader uses @ref ZPACK_VERIFY_BACKGROUND.
+ * @param reader The reader.
+ */
+ZPACK_EXPORT void zpack_flush_verifier(zpack_reader* reader);
+
+/**
+ * Free a scratch buffer.
+ * @param scratch The scratch buffer.
+ */
+ZPACK_EXPORT void zpack_free_scratch(zpack_scratch* scratch);
+
+/**
+ * Get a pointer to the data of a stored (uncompressed) file without copying it. Only available
+ * for readers that read from a buffer or a memory mapped file.\n
+ * The view is valid until the reader is closed.
+ * @param reader The reader.
+ * @param entry The file entry. Its compression method must be @ref ZPACK_COMPRESSION_NONE
+ * @param data Pointer to the file's data inside the archive.
+ * @param size Size of the file's data.
+ * @param verify Whether to verify the file's hash.
+ * @return A return code (see @ref zpack_result). Returns @ref ZPACK_ERROR_NOT_AVAILABLE if the
+ *         reader reads from a file, or @ref ZPACK_ERROR_COMP_METHOD_INVALID if the file is compressed.
+ */
+ZPACK_EXPORT int zpack_get_file_view(zpack_reader* reader, zpack_file_entry* entry, const zpack_u8** data, size_t* size,
+                                     zpack_bool verify);
+
 /**
  * (Streaming) Read the raw compressed data of a file. The data will be read to the input buffer
  * (next_in) as it's intended to be decompressed to an output buffer. Reading will start from
@@ -412,6 +919,7 @@ ZPACK_EXPORT int zpack_read_raw_file_stream(zpack_reader* reader, zpack_file_ent
                match the file's compression method. You can pass NULL to use the reader's
                built-in decompression contexts.
  * @return A return code (see @ref zpack_result)
+ * @see zpack_verify_policy
  */
 ZPACK_EXPORT int zpack_read_file_stream(zpack_reader* reader, zpack_file_entry* entry, zpack_stream* stream, void* dctx);
 
@@ -454,6 +962,57 @@ ZPACK_EXPORT int zpack_init_reader_memory(zpack_reader* reader, const zpack_u8*
  */
 ZPACK_EXPORT int zpack_init_reader_memory_shared(zpack_reader* reader, zpack_u8* buffer, size_t size);
 
+/**
+ * Initializes the reader by memory mapping a file. The archive is mapped read-only and all reading
+ * functions will read straight from the mapping, so compressed data is decompressed directly from
+ * the page cache without being copied to an intermediate buffer. The mapping will be released by
+ * zpack_close_reader.
+ * @param reader The reader.
+ * @param path UTF-8 formatted path to the archive. If you're on Windows, use
+               @ref zpack_convert_wchar_to_utf8 if needed.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_init_reader_mmap(zpack_reader* reader, const char* path);
+
+/**
+ * Initializes the reader with a callback that fetches ranges of the archive, for archives kept on
+ * high latency storage (object storage, HTTP range requests, etc.).\n
+ * Reads go through a cache of blocks of reader->fetch_block_size bytes, and the missing blocks
+ * touched by a read are fetched with a single call. Reads that are at least as large as the cache
+ * are fetched directly. The end of the archive is fetched in one call when it's opened, as with
+ * @ref ZPACK_READER_TAIL_READ, so opening it takes two calls unless the CDR is larger than
+ * reader->tail_read_size. @ref zpack_read_files merges the reads of neighbouring files, and
+ * @ref zpack_prefetch with background set fills the cache ahead of time.\n
+ * The reader is thread safe in the same way as readers that use @ref ZPACK_READER_POSITIONAL_IO,
+ * which is set along with ZPACK_READER_TAIL_READ.
+ * @param reader The reader.
+ * @param size Size of the archive.
+ * @param fetch The fetch callback.
+ * @param user_data User data passed to the callback.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_init_reader_fetch(zpack_reader* reader, size_t size, zpack_fetch_callback fetch, void* user_data);
+
+/**
+ * Initializes a reader that shares the parsed CDR of another reader: the file entries, the file
+ * and directory indexes, the entry table and the archive's buffer (if it reads from one) are
+ * shared instead of being read again. Each clone has its own file handle, decompression contexts,
+ * cache and verification state, so clones can be handed to different threads. Clones of readers
+ * opened with @ref zpack_init_reader_fetch use the same fetch callback with a cache of their own.\n
+ * The shared data is freed when the last reader using it is closed, so the source can be closed
+ * before its clones. The clone uses the same options as the source.\n
+ * Cloning is not thread safe with respect to the source reader, but closing readers that share
+ * data is.
+ * @param reader The reader to initialize.
+ * @param source An initialized reader, or a clone of one.
+ * @param path UTF-8 formatted path to the archive, used to open the clone's file handle when the
+ *             source reads from a file. Ignored otherwise.
+ * @return A return code (see @ref zpack_result). Returns @ref ZPACK_ERROR_FILE_SIZE_INVALID if
+ *         the file at path isn't the same size as the source's archive, or
+ *         @ref ZPACK_ERROR_NOT_AVAILABLE if the build has no atomics support.
+ */
+ZPACK_EXPORT int zpack_clone_reader(zpack_reader* reader, zpack_reader* source, const char* path);
+
 /**
  * Resets the reader's built-in decompression contexts. This is usually done automatically, but if
  * a reading operation was stopped prematurely, this MUST be called before starting another reading
@@ -632,7 +1191,7 @@ ZPACK_EXPORT void zpack_close_writer(zpack_writer* writer);
 /** @} */ // writer
 
 /** @defgroup stream Stream
- *  zpack_stream and stream management functions.
+ *  zpack_stream, zpack_entry_stream and stream management functions.
  *  @{
  */
 
@@ -655,8 +1214,289 @@ ZPACK_EXPORT void zpack_reset_stream(zpack_stream *stream);
  */
 ZPACK_EXPORT void zpack_close_stream(zpack_stream* stream);
 
+/**
+ * Opens an entry stream for a file. The stream reads the compressed data by itself, into an
+ * internal ring buffer when reading from a file or directly from the archive's buffer otherwise.\n
+ * A stream can be opened again for another file without closing it, in which case its buffers
+ * are reused. The hash is verified following the reader's verification policy.\n
+ * Each stream keeps its own read position, so any number of streams can be interleaved on the
+ * same reader without disturbing each other. Streams read files using positional I/O, so on
+ * platforms that have it (pread/ReadFile with an offset), they can also be read from different
+ * threads and leave the reader's file position untouched. Elsewhere, streams that read from a file
+ * seek the reader's file stream and must all be used from the same thread (streams of readers that
+ * read from a buffer can always be used from different threads).
+ * @param stream The stream.
+ * @param reader The reader.
+ * @param entry The file entry.
+ * @param dctx The decompression context to be used. The context's compression library must
+               match the file's compression method. You can pass NULL to let the stream create
+               its own context, which is freed by @ref zpack_entry_stream_close.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_entry_stream_open(zpack_entry_stream* stream, zpack_reader* reader, zpack_file_entry* entry,
+                                         void* dctx);
+
+/**
+ * Reads the next chunk of decompressed data from an entry stream. The buffer is filled entirely
+ * unless the end of the file is reached, after which stream->done is set.
+ * @param stream The stream.
+ * @param buffer The output buffer.
+ * @param size Size of the output buffer.
+ * @param read_size Set to the number of bytes written to the buffer. Also set when
+                    @ref ZPACK_ERROR_FILE_HASH_MISMATCH is returned.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_entry_stream_read(zpack_entry_stream* stream, zpack_u8* buffer, size_t size, size_t* read_size);
+
+/**
+ * Closes an entry stream and frees its buffers and its own decompression context.
+ * @param stream The stream.
+ */
+ZPACK_EXPORT void zpack_entry_stream_close(zpack_entry_stream* stream);
+
+/**
+ * Called by @ref zpack_read_file_to_sink for each chunk of decompressed data.
+ * @param data The data. Only valid for the duration of the call.
+ * @param size Size of the data.
+ * @param user_data User data passed to zpack_read_file_to_sink.
+ * @return ZPACK_OK to continue, any other value to stop. The value is returned by
+ *         zpack_read_file_to_sink.
+ */
+typedef int (*zpack_sink_callback)(const zpack_u8* data, size_t size, void* user_data);
+
+/**
+ * Reads a file and passes its decompressed data to a callback in chunks, using a fixed size
+ * window (see @ref zpack_get_dstream_out_size) regardless of the file's size.\n
+ * The hash is verified incrementally following the reader's verification policy, so a
+ * corrupted file is only detected after the chunks preceding the mismatch have been passed to
+ * the callback. Stored files of readers that read from a buffer are verified first and passed to
+ * the callback in a single call, without being copied.\n
+ * A decompression context is borrowed from the reader's pool if it has one.
+ * @param reader The reader.
+ * @param entry The file entry.
+ * @param callback The callback.
+ * @param user_data User data passed to the callback.
+ * @return A return code (see @ref zpack_result), or the callback's return value if it stopped
+ *         the read.
+ */
+ZPACK_EXPORT int zpack_read_file_to_sink(zpack_reader* reader, zpack_file_entry* entry, zpack_sink_callback callback,
+                                         void* user_data);
+
 /** @} */ // stream
 
+/** @defgroup index File Index
+ *  Hash index for looking up file entries by filename.\n
+ *  The index only stores the position of each entry in its list, so it stays valid when the list
+ *  is reallocated. The reader and the writer maintain an index for their file entries automatically
+ *  (reader->file_index and writer->file_index).\n
+ *  Thread safety: Lookups are thread safe as long as the index is not being modified.
+ *  @{
+ */
+
+/**
+ * Builds a file index for a list of file entries. Any data previously held by the index will be
+ * freed. If multiple entries share the same filename, the first one is indexed.
+ * @param index The file index.
+ * @param file_entries List of file entries.
+ * @param file_count File count.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_init_file_index(zpack_file_index* index, zpack_file_entry* file_entries, zpack_u64 file_count);
+
+/**
+ * Adds a file entry to the index, growing it if needed. Nothing is added if another entry with
+ * the same filename has already been indexed.
+ * @param index The file index.
+ * @param file_entries List of file entries.
+ * @param entry_index Position of the entry to be added in the list.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_add_file_index_entry(zpack_file_index* index, zpack_file_entry* file_entries, zpack_u64 entry_index);
+
+/**
+ * Gets the first file entry with the specified filename using a file index.
+ * @param filename The filename to look for. Does not need to be null terminated.
+ * @param length Length of the filename.
+ * @param index The file index.
+ * @param file_entries List of file entries that the index was built for.
+ * @return The file entry. Returns NULL if the file doesn't exist.
+ * @see zpack_get_file_entry
+ */
+ZPACK_EXPORT zpack_file_entry* zpack_get_file_entry_indexed(const char* filename, size_t length, const zpack_file_index* index, zpack_file_entry* file_entries);
+
+/**
+ * Frees a file index.
+ * @param index The file index.
+ */
+ZPACK_EXPORT void zpack_free_file_index(zpack_file_index* index);
+
+/** @} */ // index
+
+/** @defgroup dir_index Directory Index
+ *  Directory tree built from the '/' separated filenames of a list of file entries. Empty path
+ *  components (leading, trailing or repeated separators) are ignored.\n
+ *  Thread safety: Lookups and listings are thread safe as long as the index is not being modified.
+ *  @{
+ */
+
+/**
+ * An item found by @ref zpack_list_dir
+ */
+typedef struct zpack_dir_entry_s
+{
+    const char* name;        //!< Name of the file or directory, without its path. Null terminated
+    size_t name_length;
+    zpack_file_entry* file;  //!< The file entry, NULL for directories
+    const zpack_dir_node* dir; //!< The directory, NULL for files
+    zpack_u32 depth;         //!< Depth relative to the listed directory (0 for its direct children)
+
+} zpack_dir_entry;
+
+/**
+ * Called for each item found by @ref zpack_list_dir.
+ * @param entry The file or directory.
+ * @param user_data User data passed to zpack_list_dir.
+ * @return 0 to continue listing, any other value to stop.
+ */
+typedef int (*zpack_list_dir_callback)(const zpack_dir_entry* entry, void* user_data);
+
+/**
+ * Builds a directory index for a list of file entries. Any data previously held by the index will
+ * be freed.
+ * @param index The directory index.
+ * @param file_entries List of file entries.
+ * @param file_count File count.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_init_dir_index(zpack_dir_index* index, zpack_file_entry* file_entries, zpack_u64 file_count);
+
+/**
+ * Gets a directory by its path.
+ * @param index The directory index.
+ * @param path Path of the directory. "" or "/" is the root directory.
+ * @return The directory. Returns NULL if the directory doesn't exist.
+ */
+ZPACK_EXPORT zpack_dir_node* zpack_get_dir_node(const zpack_dir_index* index, const char* path);
+
+/**
+ * Lists the contents of a directory using the reader's directory index. The files of each
+ * directory are listed first, in the order they are stored in the CDR, followed by its
+ * subdirectories. Recursive listings walk the tree depth first, listing the contents of each
+ * subdirectory after the contents of its parent.
+ * @param reader The reader. Must be opened with @ref ZPACK_READER_DIRECTORY_INDEX
+ * @param path Path of the directory. "" or "/" is the root directory.
+ * @param recursive Whether to list the contents of the subdirectories as well.
+ * @param callback Function to call for each file and directory.
+ * @param user_data User data passed to the callback.
+ * @return A return code (see @ref zpack_result). Returns @ref ZPACK_ERROR_FILE_NOT_FOUND if the
+ *         directory doesn't exist, or @ref ZPACK_ERROR_NOT_AVAILABLE if the reader has no directory index.
+ */
+ZPACK_EXPORT int zpack_list_dir(zpack_reader* reader, const char* path, zpack_bool recursive,
+                                zpack_list_dir_callback callback, void* user_data);
+
+/**
+ * Frees a directory index.
+ * @param index The directory index.
+ */
+ZPACK_EXPORT void zpack_free_dir_index(zpack_dir_index* index);
+
+/** @} */ // dir_index
+
+/** @defgroup entry_table Entry Table
+ *  Compact structure of arrays representation of an archive's file entries. Each field is stored
+ *  in an array of its own and the filenames are packed into a single string pool, which uses
+ *  less memory than a list of @ref zpack_file_entry and keeps scans over a single field (offsets,
+ *  sizes...) cache friendly.\n
+ *  Functions that take a zpack_file_entry can be used with a view of an entry
+ *  (see @ref zpack_get_entry_view).
+ *  @{
+ */
+
+/**
+ * Gets the filename of an entry in the table.
+ */
+#define ZPACK_ENTRY_TABLE_NAME(table, i) ((table)->names + (table)->name_offsets[i])
+
+/**
+ * Builds an entry table by reading the archive's CDR. Any data previously held by the table will
+ * be freed.
+ * @param table The entry table.
+ * @param reader The reader. The file entries don't need to be loaded.
+ * @return A return code (see @ref zpack_result). Returns @ref ZPACK_ERROR_FILENAME_TOO_LONG if the
+ *         filenames take up more than 4 GiB combined.
+ */
+ZPACK_EXPORT int zpack_init_entry_table(zpack_entry_table* table, zpack_reader* reader);
+
+/**
+ * Fills a file entry with the fields of an entry in the table. The filename points into the
+ * table's string pool, so the view is only valid as long as the table is.
+ * @param table The entry table.
+ * @param index Index of the entry.
+ * @param entry The file entry to fill.
+ */
+ZPACK_EXPORT void zpack_get_entry_view(const zpack_entry_table* table, zpack_u64 index, zpack_file_entry* entry);
+
+/**
+ * Finds the first entry with the specified filename using the table's index.
+ * @param table The entry table.
+ * @param filename The filename to look for. Does not need to be null terminated.
+ * @param length Length of the filename.
+ * @param index Set to the index of the entry in the table.
+ * @return A return code (see @ref zpack_result). Returns @ref ZPACK_ERROR_FILE_NOT_FOUND if the
+ *         file doesn't exist.
+ */
+ZPACK_EXPORT int zpack_find_table_entry(const zpack_entry_table* table, const char* filename, size_t length, zpack_u64* index);
+
+/**
+ * Frees an entry table.
+ * @param table The entry table.
+ */
+ZPACK_EXPORT void zpack_free_entry_table(zpack_entry_table* table);
+
+/** @} */ // entry_table
+
+/** @defgroup sidecar Sidecar Index
+ *  A sidecar index is a file stored next to an archive (e.g. archive.zpk.idx) that holds a
+ *  serialized entry table and its filename index. The arrays are stored as they are laid out in
+ *  memory, so opening an archive only needs to map the sidecar instead of parsing the CDR and
+ *  building the table.\n
+ *  A sidecar is only used if it matches the archive: its size, the offset of the CDR and a hash
+ *  of the CDR are checked when the sidecar is mapped. Sidecars are written in the byte order of
+ *  the machine and are rejected by machines with a different one.\n
+ *  Typical usage is to set reader->sidecar_path and @ref ZPACK_READER_ENTRY_TABLE
+ *  (+ @ref ZPACK_READER_SKIP_FILE_ENTRIES) before opening the archive. If the sidecar is missing
+ *  or stale, the table is built from the CDR as usual and @ref zpack_write_sidecar_index can be
+ *  called to write a new one for the next open.
+ *  @{
+ */
+
+/**
+ * Writes a sidecar index for the archive. The reader's entry table is used if it has one,
+ * otherwise a temporary table is built.
+ * @param reader The reader.
+ * @param path Path of the sidecar index. An existing file will be replaced: the index is written to
+ *             a temporary file in the same directory, which is then renamed over it, so readers
+ *             that have the old one mapped keep using it safely. On Windows, a mapped file can't be
+ *             replaced and @ref ZPACK_ERROR_WRITE_FAILED is returned instead.
+ * @return A return code (see @ref zpack_result)
+ */
+ZPACK_EXPORT int zpack_write_sidecar_index(zpack_reader* reader, const char* path);
+
+/**
+ * Maps a sidecar index and uses it as the reader's entry table, replacing the current one.
+ * The mapping is released when the reader is closed.
+ * @param reader The reader.
+ * @param path Path of the sidecar index.
+ * @return A return code (see @ref zpack_result). Returns @ref ZPACK_ERROR_FILE_HASH_MISMATCH if
+ *         the sidecar was written for another archive or an older version of the archive, or
+ *         @ref ZPACK_ERROR_BLOCK_SIZE_INVALID if it is corrupted, or @ref ZPACK_ERROR_NOT_AVAILABLE
+ *         if the reader shares its data with clones (see @ref zpack_clone_reader). The reader is
+ *         left untouched on failure.
+ */
+ZPACK_EXPORT int zpack_map_sidecar_index(zpack_reader* reader, const char* path);
+
+/** @} */ // sidecar
+
 // Utils //
 
 /** @defgroup utils Utils
@@ -692,7 +1532,8 @@ ZPACK_EXPORT size_t zpack_get_cstream_in_size(zpack_compression_method method);
 ZPACK_EXPORT size_t zpack_get_cstream_out_size(zpack_compression_method method);
 
 /**
- * Gets the first file entry with the specified filename. This does a simple linear lookup.
+ * Gets the first file entry with the specified filename. This does a simple linear lookup; use
+ * @ref zpack_get_file_entry_indexed with the reader's or writer's file_index for faster lookups.
  * @param filename The filename to look for.
  * @param file_entries List of file entries.
  * @param file_count File count.
@@ -0,0 +1,268 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ZPACK_CACHE_INITIAL_BUCKETS 64
+
+#ifdef ZPACK_HAVE_THREADS
+#define ZPACK_LOCK_CACHE(cache) zpack_mutex_lock(&(cache)->mutex)
+#define ZPACK_UNLOCK_CACHE(cache) zpack_mutex_unlock(&(cache)->mutex)
+#else
+#define ZPACK_LOCK_CACHE(cache)
+#define ZPACK_UNLOCK_CACHE(cache)
+#endif
+
+// the decompressed data follows the node in the same allocation
+typedef struct zpack_cache_node_s
+{
+    zpack_file_entry* entry;
+    struct zpack_cache_node_s* next_in_bucket;
+    struct zpack_cache_node_s* prev; // LRU list, most recently used first
+    struct zpack_cache_node_s* next;
+    size_t size;
+    size_t ref_count;
+    zpack_bool cached; // nodes that are too large for the budget are handed out without being cached
+
+} zpack_cache_node;
+
+typedef struct zpack_cache_s
+{
+#ifdef ZPACK_HAVE_THREADS
+    zpack_mutex mutex;
+#endif
+    zpack_cache_node** buckets;
+    size_t bucket_count; // power of 2
+    size_t node_count;
+
+    zpack_cache_node* head;
+    zpack_cache_node* tail;
+    size_t size;
+    size_t budget;
+
+} zpack_cache;
+
+#define ZPACK_CACHE_NODE_DATA(node) ((zpack_u8*)((node) + 1))
+#define ZPACK_CACHE_BUCKET(cache, entry) (((size_t)(uintptr_t)(entry) / sizeof(zpack_file_entry)) & ((cache)->bucket_count - 1))
+
+static zpack_cache_node* zpack_find_cache_node(zpack_cache* cache, zpack_file_entry* entry)
+{
+    zpack_cache_node* node = cache->buckets[ZPACK_CACHE_BUCKET(cache, entry)];
+    while (node && node->entry != entry)
+        node = node->next_in_bucket;
+
+    return node;
+}
+
+static void zpack_unlink_cache_node(zpack_cache* cache, zpack_cache_node* node)
+{
+    if (node->prev) node->prev->next = node->next;
+    else cache->head = node->next;
+
+    if (node->next) node->next->prev = node->prev;
+    else cache->tail = node->prev;
+}
+
+static void zpack_push_cache_node(zpack_cache* cache, zpack_cache_node* node)
+{
+    node->prev = NULL;
+    node->next = cache->head;
+    if (cache->head) cache->head->prev = node;
+    else cache->tail = node;
+    cache->head = node;
+}
+
+static void zpack_grow_cache_buckets(zpack_cache* cache)
+{
+    // a failed allocation only makes the chains longer
+    size_t bucket_count = cache->bucket_count * 2;
+    zpack_cache_node** buckets = (zpack_cache_node**)calloc(bucket_count, sizeof(zpack_cache_node*));
+    if (buckets == NULL) return;
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = bucket_count;
+    for (zpack_cache_node* node = cache->head; node; node = node->next)
+    {
+        size_t bucket = ZPACK_CACHE_BUCKET(cache, node->entry);
+        node->next_in_bucket = buckets[bucket];
+        buckets[bucket] = node;
+    }
+}
+
+static void zpack_insert_cache_node(zpack_cache* cache, zpack_cache_node* node)
+{
+    if (cache->node_count >= cache->bucket_count)
+        zpack_grow_cache_buckets(cache);
+
+    size_t bucket = ZPACK_CACHE_BUCKET(cache, node->entry);
+    node->next_in_bucket = cache->buckets[bucket];
+    cache->buckets[bucket] = node;
+    zpack_push_cache_node(cache, node);
+
+    node->cached = ZPACK_TRUE;
+    ++cache->node_count;
+    cache->size += node->size;
+}
+
+static void zpack_remove_cache_node(zpack_cache* cache, zpack_cache_node* node)
+{
+    zpack_cache_node** p = cache->buckets + ZPACK_CACHE_BUCKET(cache, node->entry);
+    while (*p != node)
+        p = &(*p)->next_in_bucket;
+    *p = node->next_in_bucket;
+
+    zpack_unlink_cache_node(cache, node);
+    --cache->node_count;
+    cache->size -= node->size;
+}
+
+// evicts the least recently used files that aren't referenced until the cache fits in its budget
+static void zpack_trim_cache(zpack_cache* cache)
+{
+    zpack_cache_node* node = cache->tail;
+    while (node && cache->size > cache->budget)
+    {
+        zpack_cache_node* prev = node->prev;
+        if (!node->ref_count)
+        {
+            zpack_remove_cache_node(cache, node);
+            free(node);
+        }
+        node = prev;
+    }
+}
+
+int zpack_init_cache(zpack_reader* reader)
+{
+    zpack_free_cache(reader);
+    if (!reader->cache_budget) return ZPACK_OK;
+
+    zpack_cache* cache = (zpack_cache*)calloc(1, sizeof(zpack_cache));
+    if (cache == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    cache->budget = reader->cache_budget;
+    cache->bucket_count = ZPACK_CACHE_INITIAL_BUCKETS;
+    cache->buckets = (zpack_cache_node**)calloc(cache->bucket_count, sizeof(zpack_cache_node*));
+    if (cache->buckets == NULL)
+    {
+        free(cache);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+
+#ifdef ZPACK_HAVE_THREADS
+    int ret;
+    if ((ret = zpack_mutex_init(&cache->mutex)))
+    {
+        free(cache->buckets);
+        free(cache);
+        return ret;
+    }
+#endif
+
+    reader->cache = cache;
+    return ZPACK_OK;
+}
+
+int zpack_read_file_cached(zpack_reader* reader, zpack_file_entry* entry, const zpack_u8** data)
+{
+    zpack_cache* cache = (zpack_cache*)reader->cache;
+    zpack_cache_node* node;
+    if (cache)
+    {
+        ZPACK_LOCK_CACHE(cache);
+        if ((node = zpack_find_cache_node(cache, entry)))
+        {
+            ++node->ref_count;
+            zpack_unlink_cache_node(cache, node);
+            zpack_push_cache_node(cache, node);
+            ZPACK_UNLOCK_CACHE(cache);
+
+            *data = ZPACK_CACHE_NODE_DATA(node);
+            return ZPACK_OK;
+        }
+        ZPACK_UNLOCK_CACHE(cache);
+    }
+
+    // decompress outside of the lock, so that misses don't block hits
+    if (entry->uncomp_size > SIZE_MAX - sizeof(zpack_cache_node)) return ZPACK_ERROR_MALLOC_FAILED;
+    node = (zpack_cache_node*)malloc(sizeof(zpack_cache_node) + (size_t)entry->uncomp_size);
+    if (node == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    memset(node, 0, sizeof(zpack_cache_node));
+    node->entry = entry;
+    node->size = (size_t)entry->uncomp_size;
+    node->ref_count = 1;
+
+    int ret;
+    if ((ret = zpack_read_file(reader, entry, ZPACK_CACHE_NODE_DATA(node), node->size, NULL)))
+    {
+        free(node);
+        return ret;
+    }
+
+    if (cache && node->size <= cache->budget)
+    {
+        ZPACK_LOCK_CACHE(cache);
+
+        // another thread might have read the same file in the meantime
+        zpack_cache_node* existing = zpack_find_cache_node(cache, entry);
+        if (existing)
+        {
+            ++existing->ref_count;
+            zpack_unlink_cache_node(cache, existing);
+            zpack_push_cache_node(cache, existing);
+            free(node);
+            node = existing;
+        }
+        else
+        {
+            zpack_insert_cache_node(cache, node);
+            zpack_trim_cache(cache);
+        }
+
+        ZPACK_UNLOCK_CACHE(cache);
+    }
+
+    *data = ZPACK_CACHE_NODE_DATA(node);
+    return ZPACK_OK;
+}
+
+void zpack_release_cached_file(zpack_reader* reader, const zpack_u8* data)
+{
+    if (!data) return;
+
+    zpack_cache_node* node = (zpack_cache_node*)data - 1;
+    if (!node->cached)
+    {
+        free(node);
+        return;
+    }
+
+    zpack_cache* cache = (zpack_cache*)reader->cache;
+    ZPACK_LOCK_CACHE(cache);
+    --node->ref_count;
+    zpack_trim_cache(cache);
+    ZPACK_UNLOCK_CACHE(cache);
+}
+
+void zpack_free_cache(zpack_reader* reader)
+{
+    zpack_cache* cache = (zpack_cache*)reader->cache;
+    if (!cache) return;
+
+    zpack_cache_node* node = cache->head;
+    while (node)
+    {
+        zpack_cache_node* next = node->next;
+        free(node);
+        node = next;
+    }
+
+#ifdef ZPACK_HAVE_THREADS
+    zpack_mutex_destroy(&cache->mutex);
+#endif
+    free(cache->buckets);
+    free(cache);
+    reader->cache = NULL;
+}
@@ -1,6 +1,16 @@
 #include "zpack_common.h"
 #include "zpack.h"
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#define ZPACK_HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // Windows specific
 #ifdef _WIN32
@@ -97,9 +107,476 @@ int zpack_check_and_grow_heap(zpack_u8** buffer, size_t* capacity, zpack_u64 nee
         if (cap > SIZE_MAX)
             return ZPACK_ERROR_MALLOC_FAILED;
         
+        // keep the old buffer intact if the allocation fails
+        zpack_u8* tmp = (zpack_u8*)realloc(*buffer, sizeof(zpack_u8) * (size_t)cap);
+        if (tmp == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+        *buffer = tmp;
         *capacity = (size_t)cap;
-        *buffer = (zpack_u8*)realloc(*buffer, sizeof(zpack_u8) * (*capacity));
-        if (*buffer == NULL) return ZPACK_ERROR_MALLOC_FAILED;
     }
     return ZPACK_OK;
-}
\ No newline at end of file
+}
+
+#ifdef _WIN32
+#include <io.h>
+int zpack_read_file_at(FILE* fp, zpack_u64 offset, zpack_u8* buffer, size_t size)
+{
+    HANDLE file = (HANDLE)_get_osfhandle(_fileno(fp));
+    if (file == INVALID_HANDLE_VALUE)
+        return ZPACK_ERROR_NOT_AVAILABLE;
+
+    while (size > 0)
+    {
+        OVERLAPPED ov;
+        memset(&ov, 0, sizeof(OVERLAPPED));
+        ov.Offset = (DWORD)offset;
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+
+        DWORD read_size = (DWORD)ZPACK_MIN(size, 0x80000000U);
+        DWORD bytes_read;
+        if (!ReadFile(file, buffer, read_size, &bytes_read, &ov) || bytes_read == 0)
+            return ZPACK_ERROR_READ_FAILED;
+
+        buffer += bytes_read;
+        offset += bytes_read;
+        size -= bytes_read;
+    }
+    return ZPACK_OK;
+}
+
+#elif defined(ZPACK_HAVE_MMAP)
+int zpack_read_file_at(FILE* fp, zpack_u64 offset, zpack_u8* buffer, size_t size)
+{
+    int fd = fileno(fp);
+    if (fd == -1)
+        return ZPACK_ERROR_NOT_AVAILABLE;
+
+    while (size > 0)
+    {
+        ssize_t bytes_read = pread(fd, buffer, size, (off_t)offset);
+        if (bytes_read <= 0)
+        {
+            if (bytes_read == -1 && errno == EINTR) continue;
+            return ZPACK_ERROR_READ_FAILED;
+        }
+
+        buffer += bytes_read;
+        offset += bytes_read;
+        size -= (size_t)bytes_read;
+    }
+    return ZPACK_OK;
+}
+
+#else
+int zpack_read_file_at(FILE* fp, zpack_u64 offset, zpack_u8* buffer, size_t size)
+{
+    return ZPACK_ERROR_NOT_AVAILABLE;
+}
+
+#endif
+
+#ifdef _WIN32
+int zpack_map_file(const char* path, zpack_u8** buffer, size_t* size)
+{
+#ifndef ZPACK_DISABLE_UNICODE
+    wchar_t w_path[1024];
+    if (0 == MultiByteToWideChar(65001 /* UTF8 */, 0, path, -1, w_path, sizeof(w_path)/sizeof(*w_path)))
+        return ZPACK_ERROR_OPEN_FAILED;
+
+    HANDLE file = CreateFileW(w_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+#endif
+    if (file == INVALID_HANDLE_VALUE)
+        return ZPACK_ERROR_OPEN_FAILED;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        return ZPACK_ERROR_READ_FAILED;
+    }
+    if (file_size.QuadPart < ZPACK_MINIMUM_ARCHIVE_SIZE)
+    {
+        CloseHandle(file);
+        return ZPACK_ERROR_FILE_TOO_SMALL;
+    }
+    if ((zpack_u64)file_size.QuadPart > SIZE_MAX)
+    {
+        CloseHandle(file);
+        return ZPACK_ERROR_MAP_FAILED;
+    }
+
+    // the view stays valid after both handles have been closed
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return ZPACK_ERROR_MAP_FAILED;
+
+    *buffer = (zpack_u8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (*buffer == NULL)
+        return ZPACK_ERROR_MAP_FAILED;
+
+    *size = (size_t)file_size.QuadPart;
+    return ZPACK_OK;
+}
+
+void zpack_unmap_file(zpack_u8* buffer, size_t size)
+{
+    (void)size;
+    if (buffer) UnmapViewOfFile(buffer);
+}
+
+#elif defined(ZPACK_HAVE_MMAP)
+int zpack_map_file(const char* path, zpack_u8** buffer, size_t* size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return ZPACK_ERROR_OPEN_FAILED;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return ZPACK_ERROR_READ_FAILED;
+    }
+    if (st.st_size < ZPACK_MINIMUM_ARCHIVE_SIZE)
+    {
+        close(fd);
+        return ZPACK_ERROR_FILE_TOO_SMALL;
+    }
+    if ((zpack_u64)st.st_size > SIZE_MAX)
+    {
+        close(fd);
+        return ZPACK_ERROR_MAP_FAILED;
+    }
+
+    // the mapping stays valid after the descriptor has been closed
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return ZPACK_ERROR_MAP_FAILED;
+
+    *buffer = (zpack_u8*)p;
+    *size = (size_t)st.st_size;
+    return ZPACK_OK;
+}
+
+void zpack_unmap_file(zpack_u8* buffer, size_t size)
+{
+    if (buffer) munmap(buffer, size);
+}
+
+#else
+int zpack_map_file(const char* path, zpack_u8** buffer, size_t* size)
+{
+    return ZPACK_ERROR_NOT_AVAILABLE;
+}
+
+void zpack_unmap_file(zpack_u8* buffer, size_t size)
+{
+}
+
+#endif
+
+#ifdef _WIN32
+FILE* zpack_create_temp_file(const char* path, char* temp_path, size_t size)
+{
+    // "x" fails if the file already exists, so concurrent writers each get a file of their own
+    for (int attempt = 0; attempt < ZPACK_TEMP_FILE_ATTEMPTS; ++attempt)
+    {
+        snprintf(temp_path, size, "%s.%lu.%d.tmp", path, (unsigned long)GetCurrentProcessId(), attempt);
+        FILE* fp = ZPACK_FOPEN(temp_path, "wbx");
+        if (fp) return fp;
+    }
+    return NULL;
+}
+
+int zpack_replace_file(const char* from, const char* to)
+{
+#ifndef ZPACK_DISABLE_UNICODE
+    wchar_t w_from[1024];
+    wchar_t w_to[1024];
+    if (0 == MultiByteToWideChar(65001 /* UTF8 */, 0, from, -1, w_from, sizeof(w_from)/sizeof(*w_from)) ||
+        0 == MultiByteToWideChar(65001 /* UTF8 */, 0, to, -1, w_to, sizeof(w_to)/sizeof(*w_to)))
+        return ZPACK_ERROR_OPEN_FAILED;
+
+    if (!MoveFileExW(w_from, w_to, MOVEFILE_REPLACE_EXISTING))
+        return ZPACK_ERROR_WRITE_FAILED;
+#else
+    if (!MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING))
+        return ZPACK_ERROR_WRITE_FAILED;
+#endif
+    return ZPACK_OK;
+}
+
+void zpack_remove_file(const char* path)
+{
+#ifndef ZPACK_DISABLE_UNICODE
+    wchar_t w_path[1024];
+    if (MultiByteToWideChar(65001 /* UTF8 */, 0, path, -1, w_path, sizeof(w_path)/sizeof(*w_path)))
+        DeleteFileW(w_path);
+#else
+    DeleteFileA(path);
+#endif
+}
+
+#elif defined(ZPACK_HAVE_MMAP)
+FILE* zpack_create_temp_file(const char* path, char* temp_path, size_t size)
+{
+    // O_EXCL fails if the file already exists, so concurrent writers each get a file of their own
+    for (int attempt = 0; attempt < ZPACK_TEMP_FILE_ATTEMPTS; ++attempt)
+    {
+        snprintf(temp_path, size, "%s.%lu.%d.tmp", path, (unsigned long)getpid(), attempt);
+        int fd = open(temp_path, O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if (fd == -1)
+        {
+            if (errno == EEXIST) continue;
+            return NULL;
+        }
+
+        FILE* fp = fdopen(fd, "wb");
+        if (fp == NULL)
+        {
+            close(fd);
+            unlink(temp_path);
+        }
+        return fp;
+    }
+    return NULL;
+}
+
+int zpack_replace_file(const char* from, const char* to)
+{
+    // readers that mapped the old file keep it until they unmap it
+    return rename(from, to) == 0 ? ZPACK_OK : ZPACK_ERROR_WRITE_FAILED;
+}
+
+void zpack_remove_file(const char* path)
+{
+    unlink(path);
+}
+
+#else
+FILE* zpack_create_temp_file(const char* path, char* temp_path, size_t size)
+{
+    snprintf(temp_path, size, "%s.tmp", path);
+    return ZPACK_FOPEN(temp_path, "wb");
+}
+
+int zpack_replace_file(const char* from, const char* to)
+{
+    // rename doesn't have to replace an existing file
+    remove(to);
+    return rename(from, to) == 0 ? ZPACK_OK : ZPACK_ERROR_WRITE_FAILED;
+}
+
+void zpack_remove_file(const char* path)
+{
+    remove(path);
+}
+
+#endif
+
+#ifdef ZPACK_HAVE_ATOMICS
+#ifdef _MSC_VER
+void* zpack_atomic_load_ptr(void* volatile* p)
+{
+    return InterlockedCompareExchangePointer(p, NULL, NULL);
+}
+
+void* zpack_atomic_exchange_ptr(void* volatile* p, void* value)
+{
+    return InterlockedExchangePointer(p, value);
+}
+
+zpack_bool zpack_atomic_cas_ptr(void* volatile* p, void* expected, void* desired)
+{
+    return InterlockedCompareExchangePointer(p, desired, expected) == expected;
+}
+
+zpack_u32 zpack_atomic_load_u32(volatile zpack_u32* p)
+{
+    return (zpack_u32)InterlockedCompareExchange((volatile LONG*)p, 0, 0);
+}
+
+void zpack_atomic_or_u32(volatile zpack_u32* p, zpack_u32 value)
+{
+    InterlockedOr((volatile LONG*)p, (LONG)value);
+}
+
+zpack_u64 zpack_atomic_load_u64(volatile zpack_u64* p)
+{
+    return (zpack_u64)InterlockedCompareExchange64((volatile LONG64*)p, 0, 0);
+}
+
+zpack_bool zpack_atomic_cas_u64(volatile zpack_u64* p, zpack_u64 expected, zpack_u64 desired)
+{
+    return (zpack_u64)InterlockedCompareExchange64((volatile LONG64*)p, (LONG64)desired, (LONG64)expected) == expected;
+}
+
+size_t zpack_atomic_fetch_add_size(volatile size_t* p, size_t value)
+{
+#ifdef _WIN64
+    return (size_t)InterlockedExchangeAdd64((volatile LONG64*)p, (LONG64)value);
+#else
+    return (size_t)InterlockedExchangeAdd((volatile LONG*)p, (LONG)value);
+#endif
+}
+
+void zpack_atomic_store_size(volatile size_t* p, size_t value)
+{
+#ifdef _WIN64
+    InterlockedExchange64((volatile LONG64*)p, (LONG64)value);
+#else
+    InterlockedExchange((volatile LONG*)p, (LONG)value);
+#endif
+}
+
+#else
+void* zpack_atomic_load_ptr(void* volatile* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void* zpack_atomic_exchange_ptr(void* volatile* p, void* value)
+{
+    return __atomic_exchange_n(p, value, __ATOMIC_ACQ_REL);
+}
+
+zpack_bool zpack_atomic_cas_ptr(void* volatile* p, void* expected, void* desired)
+{
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+zpack_u32 zpack_atomic_load_u32(volatile zpack_u32* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void zpack_atomic_or_u32(volatile zpack_u32* p, zpack_u32 value)
+{
+    __atomic_fetch_or(p, value, __ATOMIC_ACQ_REL);
+}
+
+zpack_u64 zpack_atomic_load_u64(volatile zpack_u64* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+zpack_bool zpack_atomic_cas_u64(volatile zpack_u64* p, zpack_u64 expected, zpack_u64 desired)
+{
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+size_t zpack_atomic_fetch_add_size(volatile size_t* p, size_t value)
+{
+    return __atomic_fetch_add(p, value, __ATOMIC_ACQ_REL);
+}
+
+void zpack_atomic_store_size(volatile size_t* p, size_t value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+#endif
+#endif // ZPACK_HAVE_ATOMICS
+
+#ifdef ZPACK_HAVE_THREADS
+typedef struct zpack_thread_start_s
+{
+    zpack_thread_func func;
+    void* arg;
+
+} zpack_thread_start;
+
+#ifdef _WIN32
+static DWORD WINAPI zpack_thread_main(LPVOID param)
+#else
+static void* zpack_thread_main(void* param)
+#endif
+{
+    zpack_thread_start start = *(zpack_thread_start*)param;
+    free(param);
+    start.func(start.arg);
+    return 0;
+}
+
+int zpack_thread_create(zpack_thread* thread, zpack_thread_func func, void* arg)
+{
+    zpack_thread_start* start = (zpack_thread_start*)malloc(sizeof(zpack_thread_start));
+    if (start == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+    start->func = func;
+    start->arg = arg;
+
+#ifdef _WIN32
+    if ((*thread = CreateThread(NULL, 0, zpack_thread_main, start, 0, NULL)) == NULL)
+#else
+    if (pthread_create(thread, NULL, zpack_thread_main, start) != 0)
+#endif
+    {
+        free(start);
+        return ZPACK_ERROR_NOT_AVAILABLE;
+    }
+
+    return ZPACK_OK;
+}
+
+#ifdef _WIN32
+void zpack_thread_join(zpack_thread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+int zpack_mutex_init(zpack_mutex* mutex)
+{
+    InitializeCriticalSection(mutex);
+    return ZPACK_OK;
+}
+
+void zpack_mutex_destroy(zpack_mutex* mutex) { DeleteCriticalSection(mutex); }
+void zpack_mutex_lock(zpack_mutex* mutex) { EnterCriticalSection(mutex); }
+void zpack_mutex_unlock(zpack_mutex* mutex) { LeaveCriticalSection(mutex); }
+
+int zpack_cond_init(zpack_cond* cond)
+{
+    InitializeConditionVariable(cond);
+    return ZPACK_OK;
+}
+
+void zpack_cond_destroy(zpack_cond* cond) { (void)cond; }
+void zpack_cond_wait(zpack_cond* cond, zpack_mutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+void zpack_cond_signal(zpack_cond* cond) { WakeConditionVariable(cond); }
+void zpack_cond_broadcast(zpack_cond* cond) { WakeAllConditionVariable(cond); }
+
+#else
+void zpack_thread_join(zpack_thread thread)
+{
+    pthread_join(thread, NULL);
+}
+
+int zpack_mutex_init(zpack_mutex* mutex)
+{
+    return pthread_mutex_init(mutex, NULL) == 0 ? ZPACK_OK : ZPACK_ERROR_NOT_AVAILABLE;
+}
+
+void zpack_mutex_destroy(zpack_mutex* mutex) { pthread_mutex_destroy(mutex); }
+void zpack_mutex_lock(zpack_mutex* mutex) { pthread_mutex_lock(mutex); }
+void zpack_mutex_unlock(zpack_mutex* mutex) { pthread_mutex_unlock(mutex); }
+
+int zpack_cond_init(zpack_cond* cond)
+{
+    return pthread_cond_init(cond, NULL) == 0 ? ZPACK_OK : ZPACK_ERROR_NOT_AVAILABLE;
+}
+
+void zpack_cond_destroy(zpack_cond* cond) { pthread_cond_destroy(cond); }
+void zpack_cond_wait(zpack_cond* cond, zpack_mutex* mutex) { pthread_cond_wait(cond, mutex); }
+void zpack_cond_signal(zpack_cond* cond) { pthread_cond_signal(cond); }
+void zpack_cond_broadcast(zpack_cond* cond) { pthread_cond_broadcast(cond); }
+
+#endif
+#endif // ZPACK_HAVE_THREADS
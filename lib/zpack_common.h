@@ -32,6 +32,146 @@ int zpack_seek_and_write(FILE* fp, size_t offset, const zpack_u8* buffer, size_t
 zpack_u64 zpack_get_heap_size(zpack_u64 n);
 int zpack_check_and_grow_heap(zpack_u8** buffer, size_t* capacity, zpack_u64 needed);
 
+// positional read that doesn't use or modify the file stream's position, returns ZPACK_ERROR_NOT_AVAILABLE
+// on platforms without pread/ReadFile with an offset
+#if defined(_WIN32) || defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#define ZPACK_HAVE_READ_FILE_AT
+#endif
+int zpack_read_file_at(FILE* fp, zpack_u64 offset, zpack_u8* buffer, size_t size);
+
+// atomic pointer operations (used by the decompression context pool)
+#if defined(_MSC_VER) || defined(__GNUC__)
+#define ZPACK_HAVE_ATOMICS
+void* zpack_atomic_load_ptr(void* volatile* p);
+void* zpack_atomic_exchange_ptr(void* volatile* p, void* value);
+zpack_bool zpack_atomic_cas_ptr(void* volatile* p, void* expected, void* desired);
+zpack_u32 zpack_atomic_load_u32(volatile zpack_u32* p);
+void zpack_atomic_or_u32(volatile zpack_u32* p, zpack_u32 value);
+zpack_u64 zpack_atomic_load_u64(volatile zpack_u64* p);
+zpack_bool zpack_atomic_cas_u64(volatile zpack_u64* p, zpack_u64 expected, zpack_u64 desired);
+size_t zpack_atomic_fetch_add_size(volatile size_t* p, size_t value);
+void zpack_atomic_store_size(volatile size_t* p, size_t value);
+#endif
+
+// threads
+#if defined(_WIN32)
+#define ZPACK_HAVE_THREADS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+typedef HANDLE zpack_thread;
+typedef CRITICAL_SECTION zpack_mutex;
+typedef CONDITION_VARIABLE zpack_cond;
+
+#elif defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#define ZPACK_HAVE_THREADS
+#include <pthread.h>
+typedef pthread_t zpack_thread;
+typedef pthread_mutex_t zpack_mutex;
+typedef pthread_cond_t zpack_cond;
+#endif
+
+#ifdef ZPACK_HAVE_THREADS
+typedef void (*zpack_thread_func)(void* arg);
+int zpack_thread_create(zpack_thread* thread, zpack_thread_func func, void* arg);
+void zpack_thread_join(zpack_thread thread);
+
+int zpack_mutex_init(zpack_mutex* mutex);
+void zpack_mutex_destroy(zpack_mutex* mutex);
+void zpack_mutex_lock(zpack_mutex* mutex);
+void zpack_mutex_unlock(zpack_mutex* mutex);
+
+int zpack_cond_init(zpack_cond* cond);
+void zpack_cond_destroy(zpack_cond* cond);
+void zpack_cond_wait(zpack_cond* cond, zpack_mutex* mutex);
+void zpack_cond_signal(zpack_cond* cond);
+void zpack_cond_broadcast(zpack_cond* cond);
+#endif
+
+// hash verification (see zpack_verify.c)
+int zpack_init_verifier(zpack_reader* reader);
+int zpack_begin_verify(zpack_reader* reader, zpack_file_entry* entry, zpack_bool* verify);
+void zpack_end_verify(zpack_reader* reader, zpack_file_entry* entry);
+void zpack_free_verifier(zpack_reader* reader);
+
+// decompressed file cache (see zpack_cache.c)
+int zpack_init_cache(zpack_reader* reader);
+void zpack_free_cache(zpack_reader* reader);
+
+// stops the background prefetch thread (see zpack_prefetch.c)
+void zpack_free_prefetcher(zpack_reader* reader);
+
+// range fetch backend (see zpack_fetch.c), readers with a fetch callback are read like files
+#define ZPACK_READER_HAS_IO(reader) ((reader)->file || (reader)->fetch)
+int zpack_init_fetch_cache(zpack_reader* reader);
+int zpack_fetch_archive_at(zpack_reader* reader, zpack_u64 offset, zpack_u8* buffer, size_t size);
+void zpack_free_fetch_cache(zpack_reader* reader);
+
+// entry table layout (see zpack_table.c), the arrays are followed by the string pool in a single block
+#define ZPACK_ENTRY_TABLE_ROW_SIZE (sizeof(zpack_u64) * 4 + sizeof(zpack_u32) + sizeof(zpack_u8))
+void zpack_layout_entry_table(zpack_entry_table* table, zpack_u8* buffer, zpack_u64 count);
+int zpack_init_entry_table_index(zpack_entry_table* table);
+
+// hashes the CDR header and block, used to validate sidecar indexes (see zpack_sidecar.c)
+int zpack_hash_cdr(zpack_reader* reader, zpack_u64* hash);
+
+// maps the sidecar index if there's a valid one, builds the entry table otherwise
+int zpack_load_entry_table(zpack_reader* reader);
+
+// CDR parsing (see zpack_read.c and zpack_parallel.c)
+int zpack_parse_file_entries(const zpack_u8* buffer, zpack_u64 block_size, zpack_file_entry* entries, zpack_u64 count,
+                             char* arena, zpack_u64 arena_size, zpack_u64* parsed, zpack_u64* total_cs, zpack_u64* total_us);
+// points into the CDR if it's already in memory, allocates a buffer otherwise
+int zpack_read_cdr_block(zpack_reader* reader, zpack_u8** block, zpack_u64* count, zpack_u64* block_size,
+                         zpack_bool* owned);
+int zpack_read_cdr_parallel(zpack_reader* reader);
+
+// building the file index from multiple threads (see zpack_index.c)
+int zpack_reserve_file_index(zpack_file_index* index, zpack_u64 count);
+#ifdef ZPACK_HAVE_ATOMICS
+// returns whether a new slot was taken. Duplicate filenames keep the entry with the lowest index
+zpack_bool zpack_insert_file_index_concurrent(zpack_file_index* index, zpack_file_entry* file_entries,
+                                              const zpack_u64* hashes, zpack_u64 entry_index);
+#endif
+
+// same as zpack_read_file_scratch, with the choice of positional I/O made by the caller instead of the reader's flags
+int zpack_read_file_io(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size,
+                       void* dctx, zpack_scratch* scratch, zpack_bool positional);
+
+// qsort comparator for zpack_read_request pointers, orders by file offset
+int zpack_compare_read_requests(const void* a, const void* b);
+
+// reads and verifies a file regardless of the verification policy, growing the buffers as needed
+int zpack_verify_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8** buffer, size_t* capacity,
+                      zpack_scratch* scratch);
+
+// io_uring backend for zpack_read_files (see zpack_uring.c), needs atomics to check out the reader's ring
+#if defined(ZPACK_HAVE_IO_URING) && !defined(ZPACK_HAVE_ATOMICS)
+#undef ZPACK_HAVE_IO_URING
+#endif
+
+#ifdef ZPACK_HAVE_IO_URING
+int zpack_uring_init(void** ring, unsigned entries);
+unsigned zpack_uring_entries(void* ring);
+int zpack_uring_queue_read(void* ring, FILE* fp, zpack_u8* buffer, size_t size, zpack_u64 offset, zpack_u64 user_data);
+int zpack_uring_queue_cancel(void* ring, zpack_u64 target, zpack_u64 user_data); // cancels the request queued with target as its user data
+int zpack_uring_wait(void* ring, zpack_u64* user_data, int* result); // submits the queued reads and waits for a completion
+void zpack_uring_free(void* ring);
+#endif
+
+// read-only file mapping
+int zpack_map_file(const char* path, zpack_u8** buffer, size_t* size);
+void zpack_unmap_file(zpack_u8* buffer, size_t size);
+
+// files that are written next to their destination and renamed over it once complete. The temp
+// path needs ZPACK_TEMP_FILE_SUFFIX_SIZE more bytes than the destination's path
+#define ZPACK_TEMP_FILE_SUFFIX_SIZE 48
+#define ZPACK_TEMP_FILE_ATTEMPTS 100
+FILE* zpack_create_temp_file(const char* path, char* temp_path, size_t size);
+int zpack_replace_file(const char* from, const char* to);
+void zpack_remove_file(const char* path);
+
 // Platform specific stuff
 
 // Windows
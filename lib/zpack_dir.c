@@ -0,0 +1,390 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <xxhash.h>
+
+#define ZPACK_DIR_INDEX_MIN_CAPACITY 16
+#define ZPACK_PATH_SEPARATOR '/'
+
+static zpack_u64 zpack_hash_dir_name(zpack_u64 parent, const char* name, size_t length)
+{
+    return XXH3_64bits_withSeed(name, length, parent);
+}
+
+static zpack_u64 zpack_find_dir_node(const zpack_dir_index* index, zpack_u64 parent, const char* name, size_t length)
+{
+    if (!index->capacity) return 0;
+
+    zpack_u64 hash = zpack_hash_dir_name(parent, name, length);
+    zpack_u64 mask = index->capacity - 1;
+    for (zpack_u64 i = hash & mask; index->slots[i].entry; i = (i + 1) & mask)
+    {
+        zpack_file_index_slot* slot = index->slots + i;
+        zpack_dir_node* node = index->dirs + (slot->entry - 1);
+        if (slot->hash == hash && node->parent == parent && node->name_length == length &&
+            memcmp(index->names + node->name_offset, name, length) == 0)
+            return slot->entry;
+    }
+
+    return 0;
+}
+
+static void zpack_insert_dir_node_slot(zpack_dir_index* index, zpack_u64 node)
+{
+    zpack_dir_node* dir = index->dirs + node;
+    zpack_u64 hash = zpack_hash_dir_name(dir->parent, index->names + dir->name_offset, (size_t)dir->name_length);
+    zpack_u64 mask = index->capacity - 1;
+    zpack_u64 i = hash & mask;
+    while (index->slots[i].entry)
+        i = (i + 1) & mask;
+
+    index->slots[i].hash = hash;
+    index->slots[i].entry = node + 1;
+}
+
+// rebuilds the lookup table for all directories except the root, keeping the load factor at or below 1/2
+static int zpack_rebuild_dir_slots(zpack_dir_index* index, zpack_u64 dir_count)
+{
+    zpack_u64 capacity = ZPACK_MAX(ZPACK_DIR_INDEX_MIN_CAPACITY, zpack_get_heap_size(dir_count * 2));
+    if (capacity > SIZE_MAX / sizeof(zpack_file_index_slot)) return ZPACK_ERROR_MALLOC_FAILED;
+
+    zpack_file_index_slot* slots = (zpack_file_index_slot*)calloc((size_t)capacity, sizeof(zpack_file_index_slot));
+    if (slots == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    free(index->slots);
+    index->slots = slots;
+    index->capacity = capacity;
+
+    for (zpack_u64 i = 1; i < dir_count; ++i)
+        zpack_insert_dir_node_slot(index, i);
+
+    return ZPACK_OK;
+}
+
+// finds or creates the subdirectory of a directory while building the index
+static int zpack_add_dir_node(zpack_dir_index* index, zpack_u64* dir_capacity, size_t* names_capacity,
+                              zpack_u64 parent, const char* name, size_t length, zpack_u64* node)
+{
+    zpack_u64 found = zpack_find_dir_node(index, parent, name, length);
+    if (found)
+    {
+        *node = found - 1;
+        return ZPACK_OK;
+    }
+
+    int ret;
+    if (index->dir_count == *dir_capacity)
+    {
+        zpack_u64 capacity = *dir_capacity * 2;
+        if (capacity > SIZE_MAX / sizeof(zpack_dir_node)) return ZPACK_ERROR_MALLOC_FAILED;
+
+        zpack_dir_node* dirs = (zpack_dir_node*)realloc(index->dirs, sizeof(zpack_dir_node) * (size_t)capacity);
+        if (dirs == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+        index->dirs = dirs;
+        *dir_capacity = capacity;
+    }
+
+    // intern the name
+    if ((ret = zpack_check_and_grow_heap((zpack_u8**)&index->names, names_capacity, index->names_size + length + 1)))
+        return ret;
+    memcpy(index->names + index->names_size, name, length);
+    index->names[index->names_size + length] = '\0';
+
+    zpack_dir_node* dir = index->dirs + index->dir_count;
+    memset(dir, 0, sizeof(zpack_dir_node));
+    dir->parent = parent;
+    dir->name_offset = index->names_size;
+    dir->name_length = length;
+    index->names_size += length + 1;
+
+    *node = index->dir_count++;
+    if (index->dir_count * 2 > index->capacity)
+        return zpack_rebuild_dir_slots(index, index->dir_count);
+
+    zpack_insert_dir_node_slot(index, *node);
+    return ZPACK_OK;
+}
+
+// reorders the directories breadth first so that the subdirectories of each directory are contiguous,
+// and groups the files by directory. child_start needs dir_count + 1 elements
+static void zpack_layout_dir_nodes(zpack_dir_index* index, const zpack_u64* file_dirs, zpack_u64 file_count,
+                                   zpack_u64* child_start, zpack_u64* children, zpack_u64* order, zpack_dir_node* dirs)
+{
+    zpack_u64 dir_count = index->dir_count;
+
+    // children of each directory (in the order they were found)
+    memset(child_start, 0, sizeof(zpack_u64) * ((size_t)dir_count + 1));
+    for (zpack_u64 i = 1; i < dir_count; ++i)
+        ++child_start[index->dirs[i].parent + 1];
+    for (zpack_u64 i = 0; i < dir_count; ++i)
+        child_start[i + 1] += child_start[i];
+    for (zpack_u64 i = 1; i < dir_count; ++i)
+        children[child_start[index->dirs[i].parent]++] = i;
+    for (zpack_u64 i = dir_count; i > 0; --i)
+        child_start[i] = child_start[i - 1];
+    child_start[0] = 0;
+
+    // breadth first order (children are no longer needed afterwards, reuse them to map old -> new indices)
+    zpack_u64 head = 0, tail = 1;
+    order[0] = 0;
+    while (head < tail)
+    {
+        zpack_u64 dir = order[head++];
+        for (zpack_u64 i = child_start[dir]; i < child_start[dir + 1]; ++i)
+            order[tail++] = children[i];
+    }
+
+    zpack_u64* new_index = children;
+    for (zpack_u64 i = 0; i < dir_count; ++i)
+        new_index[order[i]] = i;
+
+    // the first child of a directory directly follows the last child of the previous directory
+    zpack_u64 next_child = 1;
+    for (zpack_u64 i = 0; i < dir_count; ++i)
+    {
+        zpack_u64 old = order[i];
+        dirs[i] = index->dirs[old];
+        dirs[i].parent = new_index[dirs[i].parent];
+        dirs[i].child_count = child_start[old + 1] - child_start[old];
+        dirs[i].first_child = next_child;
+        dirs[i].file_count = 0;
+        next_child += dirs[i].child_count;
+    }
+
+    // group the files by directory
+    for (zpack_u64 i = 0; i < file_count; ++i)
+        ++dirs[new_index[file_dirs[i]]].file_count;
+
+    zpack_u64 next_file = 0;
+    for (zpack_u64 i = 0; i < dir_count; ++i)
+    {
+        dirs[i].first_file = next_file;
+        next_file += dirs[i].file_count;
+        dirs[i].file_count = 0;
+    }
+
+    for (zpack_u64 i = 0; i < file_count; ++i)
+    {
+        zpack_dir_node* dir = dirs + new_index[file_dirs[i]];
+        index->files[dir->first_file + dir->file_count++] = i;
+    }
+}
+
+static int zpack_layout_dir_index(zpack_dir_index* index, const zpack_u64* file_dirs, zpack_u64 file_count)
+{
+    zpack_u64 dir_count = index->dir_count;
+    if (dir_count > SIZE_MAX / sizeof(zpack_dir_node)) return ZPACK_ERROR_MALLOC_FAILED;
+
+    zpack_u64* child_start = (zpack_u64*)malloc(sizeof(zpack_u64) * ((size_t)dir_count + 1));
+    zpack_u64* children = (zpack_u64*)malloc(sizeof(zpack_u64) * (size_t)dir_count);
+    zpack_u64* order = (zpack_u64*)malloc(sizeof(zpack_u64) * (size_t)dir_count);
+    zpack_dir_node* dirs = (zpack_dir_node*)malloc(sizeof(zpack_dir_node) * (size_t)dir_count);
+
+    int ret = ZPACK_ERROR_MALLOC_FAILED;
+    if (child_start && children && order && dirs)
+    {
+        zpack_layout_dir_nodes(index, file_dirs, file_count, child_start, children, order, dirs);
+
+        free(index->dirs);
+        index->dirs = dirs;
+        dirs = NULL;
+
+        // the lookup table needs the new indices
+        ret = zpack_rebuild_dir_slots(index, dir_count);
+    }
+
+    free(child_start);
+    free(children);
+    free(order);
+    free(dirs);
+    return ret;
+}
+
+// gets the next non-empty path component, returns ZPACK_FALSE if there's none left
+static zpack_bool zpack_next_path_component(const char** path, const char** name, size_t* length)
+{
+    const char* p = *path;
+    while (*p == ZPACK_PATH_SEPARATOR) ++p;
+    if (*p == '\0') return ZPACK_FALSE;
+
+    const char* end = strchr(p, ZPACK_PATH_SEPARATOR);
+    if (!end) end = p + strlen(p);
+
+    *name = p;
+    *length = end - p;
+    *path = end;
+    return ZPACK_TRUE;
+}
+
+static int zpack_build_dir_index(zpack_dir_index* index, zpack_file_entry* file_entries, zpack_u64 file_count,
+                                 zpack_u64* file_dirs)
+{
+    int ret;
+    zpack_u64 dir_capacity = ZPACK_DIR_INDEX_MIN_CAPACITY;
+    size_t names_capacity = 0;
+
+    index->files = (zpack_u64*)malloc(sizeof(zpack_u64) * (size_t)ZPACK_MAX(file_count, 1));
+    index->dirs = (zpack_dir_node*)malloc(sizeof(zpack_dir_node) * (size_t)dir_capacity);
+    if (!index->files || !index->dirs) return ZPACK_ERROR_MALLOC_FAILED;
+
+    // root directory (empty name)
+    if ((ret = zpack_check_and_grow_heap((zpack_u8**)&index->names, &names_capacity, 1)))
+        return ret;
+    index->names[0] = '\0';
+    index->names_size = 1;
+    memset(index->dirs, 0, sizeof(zpack_dir_node));
+    index->dir_count = 1;
+
+    if ((ret = zpack_rebuild_dir_slots(index, 1)))
+        return ret;
+
+    // find the directory of every file
+    for (zpack_u64 i = 0; i < file_count; ++i)
+    {
+        const char* path = file_entries[i].filename;
+        const char* basename = strrchr(path, ZPACK_PATH_SEPARATOR);
+        zpack_u64 dir = 0;
+
+        const char* name;
+        size_t length;
+        while (basename && zpack_next_path_component(&path, &name, &length) && name < basename)
+        {
+            if ((ret = zpack_add_dir_node(index, &dir_capacity, &names_capacity, dir, name, length, &dir)))
+                return ret;
+        }
+
+        file_dirs[i] = dir;
+    }
+
+    index->file_count = file_count;
+    return zpack_layout_dir_index(index, file_dirs, file_count);
+}
+
+int zpack_init_dir_index(zpack_dir_index* index, zpack_file_entry* file_entries, zpack_u64 file_count)
+{
+    zpack_free_dir_index(index);
+    if (file_count > SIZE_MAX / sizeof(zpack_u64)) return ZPACK_ERROR_MALLOC_FAILED;
+
+    // directory of each file, by its index in the list
+    zpack_u64* file_dirs = (zpack_u64*)malloc(sizeof(zpack_u64) * (size_t)ZPACK_MAX(file_count, 1));
+    if (file_dirs == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    int ret = zpack_build_dir_index(index, file_entries, file_count, file_dirs);
+    free(file_dirs);
+
+    if (ret) zpack_free_dir_index(index);
+    return ret;
+}
+
+zpack_dir_node* zpack_get_dir_node(const zpack_dir_index* index, const char* path)
+{
+    if (!index->dir_count) return NULL;
+
+    zpack_u64 dir = 0;
+    const char* name;
+    size_t length;
+    while (zpack_next_path_component(&path, &name, &length))
+    {
+        zpack_u64 found = zpack_find_dir_node(index, dir, name, length);
+        if (!found) return NULL;
+        dir = found - 1;
+    }
+
+    return index->dirs + dir;
+}
+
+static const char* zpack_get_basename(const char* filename)
+{
+    const char* basename = strrchr(filename, ZPACK_PATH_SEPARATOR);
+    return basename ? basename + 1 : filename;
+}
+
+int zpack_list_dir(zpack_reader* reader, const char* path, zpack_bool recursive, zpack_list_dir_callback callback,
+                   void* user_data)
+{
+    zpack_dir_index* index = &reader->dir_index;
+    if (!index->dir_count) return ZPACK_ERROR_NOT_AVAILABLE;
+
+    zpack_dir_node* start = zpack_get_dir_node(index, path);
+    if (!start) return ZPACK_ERROR_FILE_NOT_FOUND;
+
+    // depth first walk using an explicit stack, entries are (directory, depth) pairs
+    zpack_u64 stack_capacity = 16;
+    zpack_u64* stack = (zpack_u64*)malloc(sizeof(zpack_u64) * 2 * (size_t)stack_capacity);
+    if (stack == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    zpack_u64 stack_size = 1;
+    stack[0] = start - index->dirs;
+    stack[1] = 0;
+
+    zpack_dir_entry entry;
+    zpack_bool stop = ZPACK_FALSE;
+    while (stack_size && !stop)
+    {
+        --stack_size;
+        zpack_dir_node* dir = index->dirs + stack[stack_size * 2];
+        zpack_u32 depth = (zpack_u32)stack[stack_size * 2 + 1];
+
+        // files
+        for (zpack_u64 i = 0; i < dir->file_count && !stop; ++i)
+        {
+            zpack_file_entry* file = reader->file_entries + index->files[dir->first_file + i];
+            entry.name = zpack_get_basename(file->filename);
+            entry.name_length = strlen(entry.name);
+            entry.file = file;
+            entry.dir = NULL;
+            entry.depth = depth;
+            stop = callback(&entry, user_data) != 0;
+        }
+
+        // subdirectories
+        for (zpack_u64 i = 0; i < dir->child_count && !stop; ++i)
+        {
+            zpack_dir_node* child = index->dirs + dir->first_child + i;
+            entry.name = index->names + child->name_offset;
+            entry.name_length = (size_t)child->name_length;
+            entry.file = NULL;
+            entry.dir = child;
+            entry.depth = depth;
+            stop = callback(&entry, user_data) != 0;
+        }
+
+        if (!recursive || stop) continue;
+
+        // walk the subdirectories in order
+        if (stack_size + dir->child_count > stack_capacity)
+        {
+            zpack_u64 capacity = zpack_get_heap_size(stack_size + dir->child_count);
+            zpack_u64* tmp = (capacity > SIZE_MAX / (sizeof(zpack_u64) * 2)) ? NULL :
+                             (zpack_u64*)realloc(stack, sizeof(zpack_u64) * 2 * (size_t)capacity);
+            if (tmp == NULL)
+            {
+                free(stack);
+                return ZPACK_ERROR_MALLOC_FAILED;
+            }
+            stack = tmp;
+            stack_capacity = capacity;
+        }
+
+        for (zpack_u64 i = dir->child_count; i > 0; --i)
+        {
+            stack[stack_size * 2] = dir->first_child + i - 1;
+            stack[stack_size * 2 + 1] = depth + 1;
+            ++stack_size;
+        }
+    }
+
+    free(stack);
+    return ZPACK_OK;
+}
+
+void zpack_free_dir_index(zpack_dir_index* index)
+{
+    free(index->dirs);
+    free(index->files);
+    free(index->names);
+    free(index->slots);
+    memset(index, 0, sizeof(zpack_dir_index));
+}
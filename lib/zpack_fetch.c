@@ -0,0 +1,250 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ZPACK_HAVE_THREADS
+#define ZPACK_LOCK_FETCH_CACHE(cache) zpack_mutex_lock(&(cache)->mutex)
+#define ZPACK_UNLOCK_FETCH_CACHE(cache) zpack_mutex_unlock(&(cache)->mutex)
+#else
+#define ZPACK_LOCK_FETCH_CACHE(cache)
+#define ZPACK_UNLOCK_FETCH_CACHE(cache)
+#endif
+
+// the block's data follows the node in the same allocation
+typedef struct zpack_fetch_block_s
+{
+    zpack_u64 index; // offset / block size
+    struct zpack_fetch_block_s* next_in_bucket;
+    struct zpack_fetch_block_s* prev; // LRU list, most recently used first
+    struct zpack_fetch_block_s* next;
+
+} zpack_fetch_block;
+
+typedef struct zpack_fetch_cache_s
+{
+#ifdef ZPACK_HAVE_THREADS
+    zpack_mutex mutex;
+#endif
+    zpack_fetch_block** buckets;
+    size_t bucket_count; // power of 2, at least max_blocks so the chains stay short without rehashing
+
+    zpack_fetch_block* head;
+    zpack_fetch_block* tail;
+    size_t block_count;
+    size_t max_blocks;
+    size_t block_size;
+
+} zpack_fetch_cache;
+
+#define ZPACK_FETCH_BLOCK_DATA(block) ((zpack_u8*)((block) + 1))
+#define ZPACK_FETCH_BUCKET(cache, index) ((size_t)(index) & ((cache)->bucket_count - 1))
+
+static zpack_fetch_block* zpack_find_fetch_block(zpack_fetch_cache* cache, zpack_u64 index)
+{
+    zpack_fetch_block* block = cache->buckets[ZPACK_FETCH_BUCKET(cache, index)];
+    while (block && block->index != index)
+        block = block->next_in_bucket;
+
+    return block;
+}
+
+static void zpack_unlink_fetch_block(zpack_fetch_cache* cache, zpack_fetch_block* block)
+{
+    if (block->prev) block->prev->next = block->next;
+    else cache->head = block->next;
+
+    if (block->next) block->next->prev = block->prev;
+    else cache->tail = block->prev;
+}
+
+static void zpack_push_fetch_block(zpack_fetch_cache* cache, zpack_fetch_block* block)
+{
+    block->prev = NULL;
+    block->next = cache->head;
+    if (cache->head) cache->head->prev = block;
+    else cache->tail = block;
+    cache->head = block;
+}
+
+static void zpack_evict_fetch_block(zpack_fetch_cache* cache)
+{
+    zpack_fetch_block* block = cache->tail;
+    zpack_fetch_block** p = cache->buckets + ZPACK_FETCH_BUCKET(cache, block->index);
+    while (*p != block)
+        p = &(*p)->next_in_bucket;
+    *p = block->next_in_bucket;
+
+    zpack_unlink_fetch_block(cache, block);
+    --cache->block_count;
+    free(block);
+}
+
+// copies the fetched blocks into the cache, blocks that another thread cached in the meantime are kept
+static void zpack_insert_fetch_blocks(zpack_fetch_cache* cache, zpack_u64 first, zpack_u64 end, const zpack_u8* data,
+                                      size_t size)
+{
+    for (zpack_u64 index = first; index < end; ++index)
+    {
+        if (zpack_find_fetch_block(cache, index)) continue;
+
+        // a failed allocation only means that the block isn't cached
+        zpack_fetch_block* block = (zpack_fetch_block*)malloc(sizeof(zpack_fetch_block) + cache->block_size);
+        if (block == NULL) return;
+
+        // the last block of the archive is shorter, the rest of it is never read
+        size_t offset = (size_t)(index - first) * cache->block_size;
+        memcpy(ZPACK_FETCH_BLOCK_DATA(block), data + offset, ZPACK_MIN(size - offset, cache->block_size));
+        block->index = index;
+
+        if (cache->block_count == cache->max_blocks)
+            zpack_evict_fetch_block(cache);
+
+        size_t bucket = ZPACK_FETCH_BUCKET(cache, index);
+        block->next_in_bucket = cache->buckets[bucket];
+        cache->buckets[bucket] = block;
+        zpack_push_fetch_block(cache, block);
+        ++cache->block_count;
+    }
+}
+
+int zpack_init_fetch_cache(zpack_reader* reader)
+{
+    zpack_free_fetch_cache(reader);
+
+    if (!reader->fetch_block_size) reader->fetch_block_size = ZPACK_DEFAULT_FETCH_BLOCK_SIZE;
+    if (!reader->fetch_cache_size) reader->fetch_cache_size = ZPACK_DEFAULT_FETCH_CACHE_SIZE;
+
+    zpack_fetch_cache* cache = (zpack_fetch_cache*)calloc(1, sizeof(zpack_fetch_cache));
+    if (cache == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    cache->block_size = reader->fetch_block_size;
+    cache->max_blocks = ZPACK_MAX(reader->fetch_cache_size / reader->fetch_block_size, 1);
+    cache->bucket_count = 1;
+    while (cache->bucket_count < cache->max_blocks)
+        cache->bucket_count *= 2;
+
+    cache->buckets = (zpack_fetch_block**)calloc(cache->bucket_count, sizeof(zpack_fetch_block*));
+    if (cache->buckets == NULL)
+    {
+        free(cache);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+
+#ifdef ZPACK_HAVE_THREADS
+    int ret;
+    if ((ret = zpack_mutex_init(&cache->mutex)))
+    {
+        free(cache->buckets);
+        free(cache);
+        return ret;
+    }
+#endif
+
+    reader->fetch_cache = cache;
+    return ZPACK_OK;
+}
+
+int zpack_fetch_archive_at(zpack_reader* reader, zpack_u64 offset, zpack_u8* buffer, size_t size)
+{
+    if (offset > reader->file_size || size > reader->file_size - offset)
+        return ZPACK_ERROR_READ_FAILED;
+    if (size == 0) return ZPACK_OK;
+
+    // reads that would take over the whole cache are fetched as they are
+    zpack_fetch_cache* cache = (zpack_fetch_cache*)reader->fetch_cache;
+    if (size / cache->block_size >= cache->max_blocks)
+        return reader->fetch(offset, buffer, size, reader->fetch_user_data);
+
+    zpack_u64 block_size = cache->block_size;
+    zpack_u64 index = offset / block_size;
+    zpack_u64 last = (offset + size - 1) / block_size;
+    while (index <= last)
+    {
+        // the part of the block that's been requested
+        zpack_u64 block_offset = index * block_size;
+        zpack_u64 start = ZPACK_MAX(offset, block_offset);
+
+        ZPACK_LOCK_FETCH_CACHE(cache);
+        zpack_fetch_block* block = zpack_find_fetch_block(cache, index);
+        if (block)
+        {
+            zpack_u64 end = ZPACK_MIN(offset + size, block_offset + block_size);
+            memcpy(buffer + (start - offset), ZPACK_FETCH_BLOCK_DATA(block) + (start - block_offset),
+                   (size_t)(end - start));
+
+            zpack_unlink_fetch_block(cache, block);
+            zpack_push_fetch_block(cache, block);
+            ZPACK_UNLOCK_FETCH_CACHE(cache);
+
+            ++index;
+            continue;
+        }
+
+        // neighbouring blocks that are missing as well are fetched along with this one
+        zpack_u64 run_end = index + 1;
+        while (run_end <= last && !zpack_find_fetch_block(cache, run_end))
+            ++run_end;
+        ZPACK_UNLOCK_FETCH_CACHE(cache);
+
+        size_t run_size = (size_t)(ZPACK_MIN(run_end * block_size, (zpack_u64)reader->file_size) - block_offset);
+        zpack_u8* run = (zpack_u8*)malloc(run_size);
+        if (run == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+        int ret;
+        if ((ret = reader->fetch(block_offset, run, run_size, reader->fetch_user_data)))
+        {
+            free(run);
+            return ret;
+        }
+
+        zpack_u64 end = ZPACK_MIN(offset + size, block_offset + run_size);
+        memcpy(buffer + (start - offset), run + (start - block_offset), (size_t)(end - start));
+
+        ZPACK_LOCK_FETCH_CACHE(cache);
+        zpack_insert_fetch_blocks(cache, index, run_end, run, run_size);
+        ZPACK_UNLOCK_FETCH_CACHE(cache);
+
+        free(run);
+        index = run_end;
+    }
+
+    return ZPACK_OK;
+}
+
+void zpack_free_fetch_cache(zpack_reader* reader)
+{
+    zpack_fetch_cache* cache = (zpack_fetch_cache*)reader->fetch_cache;
+    if (!cache) return;
+
+    zpack_fetch_block* block = cache->head;
+    while (block)
+    {
+        zpack_fetch_block* next = block->next;
+        free(block);
+        block = next;
+    }
+
+#ifdef ZPACK_HAVE_THREADS
+    zpack_mutex_destroy(&cache->mutex);
+#endif
+    free(cache->buckets);
+    free(cache);
+    reader->fetch_cache = NULL;
+}
+
+int zpack_init_reader_fetch(zpack_reader* reader, size_t size, zpack_fetch_callback fetch, void* user_data)
+{
+    reader->fetch = fetch;
+    reader->fetch_user_data = user_data;
+    reader->file_size = size;
+
+    // reads never depend on a stream position, and the end of the archive is fetched in one go
+    reader->flags |= ZPACK_READER_POSITIONAL_IO | ZPACK_READER_TAIL_READ;
+
+    int ret;
+    if ((ret = zpack_init_fetch_cache(reader)))
+        return ret;
+
+    return zpack_read_archive(reader);
+}
@@ -0,0 +1,208 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <xxhash.h>
+
+#define ZPACK_INDEX_MIN_CAPACITY 16
+
+static zpack_bool zpack_filename_equals(const char* filename, const char* name, size_t length)
+{
+    return strncmp(filename, name, length) == 0 && filename[length] == '\0';
+}
+
+// the index works with both entry lists and entry tables
+typedef const char* (*zpack_index_name_func)(const void* list, zpack_u64 i);
+
+static const char* zpack_get_entry_list_name(const void* list, zpack_u64 i)
+{
+    return ((const zpack_file_entry*)list)[i].filename;
+}
+
+static const char* zpack_get_entry_table_name(const void* list, zpack_u64 i)
+{
+    return ZPACK_ENTRY_TABLE_NAME((const zpack_entry_table*)list, i);
+}
+
+// inserts a slot without checking for duplicates; the index must have a free slot
+static void zpack_insert_file_index_slot(zpack_file_index* index, zpack_u64 hash, zpack_u64 entry)
+{
+    zpack_u64 mask = index->capacity - 1;
+    zpack_u64 i = hash & mask;
+    while (index->slots[i].entry)
+        i = (i + 1) & mask;
+
+    index->slots[i].hash = hash;
+    index->slots[i].entry = entry;
+    ++index->count;
+}
+
+static int zpack_resize_file_index(zpack_file_index* index, zpack_u64 capacity)
+{
+    zpack_u64 size = sizeof(zpack_file_index_slot) * capacity;
+    if (size > SIZE_MAX) return ZPACK_ERROR_MALLOC_FAILED;
+
+    zpack_file_index_slot* slots = (zpack_file_index_slot*)calloc((size_t)capacity, sizeof(zpack_file_index_slot));
+    if (slots == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    zpack_file_index_slot* old_slots = index->slots;
+    zpack_u64 old_capacity = index->capacity;
+
+    index->slots = slots;
+    index->capacity = capacity;
+    index->count = 0;
+
+    // rehash
+    for (zpack_u64 i = 0; i < old_capacity; ++i)
+    {
+        if (old_slots[i].entry)
+            zpack_insert_file_index_slot(index, old_slots[i].hash, old_slots[i].entry);
+    }
+
+    free(old_slots);
+    return ZPACK_OK;
+}
+
+// keeps the load factor at or below 1/2
+static zpack_u64 zpack_get_file_index_capacity(zpack_u64 count)
+{
+    return ZPACK_MAX(ZPACK_INDEX_MIN_CAPACITY, zpack_get_heap_size(count * 2));
+}
+
+static zpack_file_index_slot* zpack_find_file_index_slot(const zpack_file_index* index, const void* list,
+                                                         zpack_index_name_func get_name, zpack_u64 hash,
+                                                         const char* filename, size_t length)
+{
+    zpack_u64 mask = index->capacity - 1;
+    for (zpack_u64 i = hash & mask; index->slots[i].entry; i = (i + 1) & mask)
+    {
+        zpack_file_index_slot* slot = index->slots + i;
+        if (slot->hash == hash && zpack_filename_equals(get_name(list, slot->entry - 1), filename, length))
+            return slot;
+    }
+
+    return NULL;
+}
+
+static int zpack_build_file_index(zpack_file_index* index, const void* list, zpack_index_name_func get_name,
+                                  zpack_u64 count)
+{
+    zpack_free_file_index(index);
+
+    int ret;
+    if ((ret = zpack_resize_file_index(index, zpack_get_file_index_capacity(count))))
+        return ret;
+
+    for (zpack_u64 i = 0; i < count; ++i)
+    {
+        const char* filename = get_name(list, i);
+        size_t length = strlen(filename);
+        zpack_u64 hash = XXH3_64bits(filename, length);
+
+        if (!zpack_find_file_index_slot(index, list, get_name, hash, filename, length))
+            zpack_insert_file_index_slot(index, hash, i + 1);
+    }
+
+    return ZPACK_OK;
+}
+
+int zpack_init_file_index(zpack_file_index* index, zpack_file_entry* file_entries, zpack_u64 file_count)
+{
+    return zpack_build_file_index(index, file_entries, zpack_get_entry_list_name, file_count);
+}
+
+int zpack_init_entry_table_index(zpack_entry_table* table)
+{
+    return zpack_build_file_index(&table->index, table, zpack_get_entry_table_name, table->count);
+}
+
+int zpack_reserve_file_index(zpack_file_index* index, zpack_u64 count)
+{
+    zpack_free_file_index(index);
+    return zpack_resize_file_index(index, zpack_get_file_index_capacity(count));
+}
+
+#ifdef ZPACK_HAVE_ATOMICS
+zpack_bool zpack_insert_file_index_concurrent(zpack_file_index* index, zpack_file_entry* file_entries,
+                                              const zpack_u64* hashes, zpack_u64 entry_index)
+{
+    zpack_u64 hash = hashes[entry_index];
+    zpack_u64 entry = entry_index + 1;
+    const char* filename = file_entries[entry_index].filename;
+
+    // slots are claimed by setting their entry, so that is the only field other threads look at
+    zpack_u64 mask = index->capacity - 1;
+    zpack_u64 i = hash & mask;
+    for (;;)
+    {
+        volatile zpack_u64* slot_entry = &index->slots[i].entry;
+        zpack_u64 current = zpack_atomic_load_u64(slot_entry);
+        if (!current)
+        {
+            if (zpack_atomic_cas_u64(slot_entry, 0, entry))
+            {
+                index->slots[i].hash = hash;
+                return ZPACK_TRUE;
+            }
+            continue; // another thread took the slot first
+        }
+
+        if (hashes[current - 1] == hash && strcmp(file_entries[current - 1].filename, filename) == 0)
+        {
+            // duplicates keep the first entry, like zpack_init_file_index does
+            while (current > entry && !zpack_atomic_cas_u64(slot_entry, current, entry))
+                current = zpack_atomic_load_u64(slot_entry);
+            return ZPACK_FALSE;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+#endif
+
+int zpack_add_file_index_entry(zpack_file_index* index, zpack_file_entry* file_entries, zpack_u64 entry_index)
+{
+    int ret;
+    if ((index->count + 1) * 2 > index->capacity)
+    {
+        if ((ret = zpack_resize_file_index(index, zpack_get_file_index_capacity(index->count + 1))))
+            return ret;
+    }
+
+    const char* filename = file_entries[entry_index].filename;
+    size_t length = strlen(filename);
+    zpack_u64 hash = XXH3_64bits(filename, length);
+
+    if (!zpack_find_file_index_slot(index, file_entries, zpack_get_entry_list_name, hash, filename, length))
+        zpack_insert_file_index_slot(index, hash, entry_index + 1);
+
+    return ZPACK_OK;
+}
+
+zpack_file_entry* zpack_get_file_entry_indexed(const char* filename, size_t length, const zpack_file_index* index,
+                                               zpack_file_entry* file_entries)
+{
+    if (index->count == 0) return NULL;
+
+    zpack_file_index_slot* slot = zpack_find_file_index_slot(index, file_entries, zpack_get_entry_list_name,
+                                                             XXH3_64bits(filename, length), filename, length);
+    return slot ? file_entries + (slot->entry - 1) : NULL;
+}
+
+int zpack_find_table_entry(const zpack_entry_table* table, const char* filename, size_t length, zpack_u64* index)
+{
+    if (table->index.count == 0) return ZPACK_ERROR_FILE_NOT_FOUND;
+
+    zpack_file_index_slot* slot = zpack_find_file_index_slot(&table->index, table, zpack_get_entry_table_name,
+                                                             XXH3_64bits(filename, length), filename, length);
+    if (!slot) return ZPACK_ERROR_FILE_NOT_FOUND;
+
+    *index = slot->entry - 1;
+    return ZPACK_OK;
+}
+
+void zpack_free_file_index(zpack_file_index* index)
+{
+    free(index->slots);
+    memset(index, 0, sizeof(zpack_file_index));
+}
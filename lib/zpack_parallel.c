@@ -0,0 +1,367 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <xxhash.h>
+
+#if defined(ZPACK_HAVE_ATOMICS) && defined(ZPACK_HAVE_THREADS)
+#define ZPACK_HAVE_PARALLEL_READ
+#endif
+
+// minimum number of entries in a chunk, CDRs with fewer than two chunks' worth are parsed on a single thread
+#define ZPACK_PARALLEL_CDR_MIN_CHUNK_SIZE 4096
+#define ZPACK_PARALLEL_CDR_MIN_ENTRIES (ZPACK_PARALLEL_CDR_MIN_CHUNK_SIZE * 2)
+#define ZPACK_PARALLEL_CDR_CHUNKS_PER_THREAD 4
+#define ZPACK_PARALLEL_CDR_MAX_THREADS 256
+
+typedef struct zpack_parallel_job_s
+{
+    zpack_reader* reader;
+    zpack_bool positional;
+    zpack_read_request** order; // requests sorted by offset
+    size_t count;
+    volatile size_t next; // index of the next request to be read
+
+    zpack_read_callback callback;
+    void* user_data;
+
+} zpack_parallel_job;
+
+static size_t zpack_next_request(zpack_parallel_job* job)
+{
+#ifdef ZPACK_HAVE_PARALLEL_READ
+    return zpack_atomic_fetch_add_size(&job->next, 1);
+#else
+    return job->next++;
+#endif
+}
+
+#ifdef ZPACK_HAVE_PARALLEL_READ
+// runs the function on up to thread_count threads and waits for them, the calling thread is one of them
+static void zpack_run_workers(zpack_thread_func func, void* arg, int thread_count)
+{
+    int started = 0;
+    zpack_thread* threads = NULL;
+    if (thread_count > 1 && (threads = (zpack_thread*)malloc(sizeof(zpack_thread) * (thread_count - 1))))
+    {
+        for (; started < thread_count - 1; ++started)
+        {
+            if (zpack_thread_create(threads + started, func, arg))
+                break;
+        }
+    }
+
+    func(arg);
+
+    for (int i = 0; i < started; ++i)
+        zpack_thread_join(threads[i]);
+    free(threads);
+}
+#endif
+
+static void zpack_parallel_worker(void* arg)
+{
+    zpack_parallel_job* job = (zpack_parallel_job*)arg;
+
+    // each worker has its own contexts and buffer
+    void* zstd_dctx = NULL;
+    void* lz4f_dctx = NULL;
+    zpack_scratch scratch = { NULL, 0 };
+
+    size_t i;
+    while ((i = zpack_next_request(job)) < job->count)
+    {
+        zpack_read_request* request = job->order[i];
+        void* dctx = NULL;
+        switch (request->entry->comp_method)
+        {
+        case ZPACK_COMPRESSION_ZSTD:
+            if (!zstd_dctx) zstd_dctx = zpack_create_dctx(ZPACK_COMPRESSION_ZSTD);
+            dctx = zstd_dctx;
+            break;
+
+        case ZPACK_COMPRESSION_LZ4:
+            if (!lz4f_dctx) lz4f_dctx = zpack_create_dctx(ZPACK_COMPRESSION_LZ4);
+            dctx = lz4f_dctx;
+            break;
+
+        default:
+            break;
+        }
+
+        request->result = zpack_read_file_io(job->reader, request->entry, request->buffer, request->max_size,
+                                             dctx, &scratch, job->positional);
+        if (job->callback) job->callback(request, job->user_data);
+    }
+
+    if (zstd_dctx) zpack_free_dctx(ZPACK_COMPRESSION_ZSTD, zstd_dctx);
+    if (lz4f_dctx) zpack_free_dctx(ZPACK_COMPRESSION_LZ4, lz4f_dctx);
+    zpack_free_scratch(&scratch);
+}
+
+int zpack_read_files_parallel(zpack_reader* reader, zpack_read_request* requests, size_t count,
+                              int thread_count, zpack_read_callback callback, void* user_data)
+{
+    if (!ZPACK_READER_HAS_IO(reader) && !reader->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+    if (count == 0) return ZPACK_OK;
+
+    zpack_parallel_job job;
+    memset(&job, 0, sizeof(job));
+    job.reader = reader;
+    job.count = count;
+    job.callback = callback;
+    job.user_data = user_data;
+
+    // hand out the files in the order they're stored in
+    job.order = (zpack_read_request**)malloc(sizeof(zpack_read_request*) * count);
+    if (job.order == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    for (size_t i = 0; i < count; ++i)
+        job.order[i] = requests + i;
+    qsort(job.order, count, sizeof(zpack_read_request*), zpack_compare_read_requests);
+
+    // workers never use the file stream's position, without positional I/O the file is read on this thread only
+#ifdef ZPACK_HAVE_READ_FILE_AT
+    job.positional = ZPACK_TRUE;
+#else
+    if (reader->file && !reader->fetch) thread_count = 1;
+#endif
+
+#ifdef ZPACK_HAVE_PARALLEL_READ
+    if (thread_count < 1) thread_count = 1;
+    if ((size_t)thread_count > count) thread_count = (int)count;
+
+    zpack_run_workers(zpack_parallel_worker, &job, thread_count);
+#else
+    zpack_parallel_worker(&job);
+#endif
+
+    free(job.order);
+
+    // report the first error
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (requests[i].result)
+            return requests[i].result;
+    }
+
+    return ZPACK_OK;
+}
+
+#ifdef ZPACK_HAVE_PARALLEL_READ
+typedef struct zpack_cdr_chunk_s
+{
+    zpack_u64 first;        // index of the first entry
+    zpack_u64 offset;       // offset of the first entry in the block
+    zpack_u64 arena_offset; // offset of the first filename in the arena
+
+    // set by the workers
+    int result;
+    zpack_u64 comp_size;
+    zpack_u64 uncomp_size;
+    zpack_u64 indexed; // number of index slots taken
+
+} zpack_cdr_chunk;
+
+typedef struct zpack_cdr_job_s
+{
+    const zpack_u8* block;
+    zpack_file_entry* entries;
+    char* arena;
+    zpack_u64* hashes;
+    zpack_file_index* index;
+
+    // the last chunk is a sentinel holding the end of the block and the arena
+    zpack_cdr_chunk* chunks;
+    size_t chunk_count;
+    volatile size_t next;
+
+} zpack_cdr_job;
+
+static void zpack_parse_cdr_worker(void* arg)
+{
+    zpack_cdr_job* job = (zpack_cdr_job*)arg;
+
+    size_t i;
+    while ((i = zpack_atomic_fetch_add_size(&job->next, 1)) < job->chunk_count)
+    {
+        zpack_cdr_chunk* chunk = job->chunks + i;
+        zpack_cdr_chunk* end = chunk + 1;
+        zpack_u64 count = end->first - chunk->first;
+        zpack_u64 parsed = 0;
+
+        chunk->result = zpack_parse_file_entries(job->block + chunk->offset, end->offset - chunk->offset,
+                                                 job->entries + chunk->first, count, job->arena + chunk->arena_offset,
+                                                 end->arena_offset - chunk->arena_offset, &parsed,
+                                                 &chunk->comp_size, &chunk->uncomp_size);
+        if (chunk->result) continue;
+
+        for (zpack_u64 j = chunk->first; j < end->first; ++j)
+        {
+            const char* filename = job->entries[j].filename;
+            job->hashes[j] = XXH3_64bits(filename, strlen(filename));
+        }
+    }
+}
+
+static void zpack_index_cdr_worker(void* arg)
+{
+    zpack_cdr_job* job = (zpack_cdr_job*)arg;
+
+    size_t i;
+    while ((i = zpack_atomic_fetch_add_size(&job->next, 1)) < job->chunk_count)
+    {
+        zpack_cdr_chunk* chunk = job->chunks + i;
+        for (zpack_u64 j = chunk->first; j < chunk[1].first; ++j)
+        {
+            if (zpack_insert_file_index_concurrent(job->index, job->entries, job->hashes, j))
+                ++chunk->indexed;
+        }
+    }
+}
+
+// index of the first entry of a chunk, k * count / chunk_count without overflowing
+static zpack_u64 zpack_get_chunk_first(zpack_u64 count, size_t chunk_count, size_t k)
+{
+    return k * (count / chunk_count) + k * (count % chunk_count) / chunk_count;
+}
+
+// walks the length fields of the entries to find where each chunk starts. Every chunk gets at least
+// one entry as long as chunk_count <= count
+static int zpack_split_cdr(const zpack_u8* block, zpack_u64 block_size, zpack_u64 count,
+                           zpack_cdr_chunk* chunks, size_t chunk_count)
+{
+    size_t next = 0;
+    zpack_u64 next_first = 0;
+    zpack_u64 offset = 0;
+    zpack_u64 arena_offset = 0;
+    for (zpack_u64 i = 0; i < count; ++i)
+    {
+        if (i == next_first)
+        {
+            zpack_cdr_chunk* chunk = chunks + next;
+            chunk->first = i;
+            chunk->offset = offset;
+            chunk->arena_offset = arena_offset;
+
+            ++next;
+            next_first = next < chunk_count ? zpack_get_chunk_first(count, chunk_count, next) : count;
+        }
+
+        if (block_size - offset < ZPACK_FILE_ENTRY_FIXED_SIZE)
+            return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+        zpack_u16 filename_len = ZPACK_READ_LE16(block + offset);
+        zpack_u64 entry_size = ZPACK_FILE_ENTRY_FIXED_SIZE + filename_len;
+        if (entry_size > block_size - offset)
+            return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+        offset += entry_size;
+        arena_offset += (zpack_u64)filename_len + 1;
+    }
+
+    zpack_cdr_chunk* sentinel = chunks + chunk_count;
+    sentinel->first = count;
+    sentinel->offset = offset;
+    sentinel->arena_offset = arena_offset;
+    return ZPACK_OK;
+}
+
+static int zpack_parse_cdr_block(zpack_reader* reader, const zpack_u8* block, zpack_u64 count, zpack_u64 block_size)
+{
+    if (count > block_size / ZPACK_FILE_ENTRY_FIXED_SIZE)
+        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+    // same layout as zpack_read_file_entries_memory, the filenames are stored right after the entries
+    zpack_u64 eb_size = sizeof(zpack_file_entry) * count;
+    zpack_u64 arena_size = block_size - count * ZPACK_FILE_ENTRY_FIXED_SIZE + count;
+    if (eb_size + arena_size > SIZE_MAX) return ZPACK_ERROR_MALLOC_FAILED;
+    reader->file_entries = (zpack_file_entry*)realloc(reader->file_entries, (size_t)(eb_size + arena_size));
+    if (reader->file_entries == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+    memset(reader->file_entries, 0, (size_t)eb_size);
+
+    int thread_count = ZPACK_MIN(reader->parse_thread_count, ZPACK_PARALLEL_CDR_MAX_THREADS);
+    size_t chunk_count = (size_t)ZPACK_MIN((zpack_u64)thread_count * ZPACK_PARALLEL_CDR_CHUNKS_PER_THREAD,
+                                           count / ZPACK_PARALLEL_CDR_MIN_CHUNK_SIZE);
+
+    zpack_cdr_job job;
+    memset(&job, 0, sizeof(job));
+    job.block = block;
+    job.entries = reader->file_entries;
+    job.arena = (char*)(reader->file_entries + count);
+    job.index = &reader->file_index;
+    job.chunk_count = chunk_count;
+    job.chunks = (zpack_cdr_chunk*)calloc(chunk_count + 1, sizeof(zpack_cdr_chunk));
+    job.hashes = (zpack_u64*)malloc(sizeof(zpack_u64) * (size_t)count);
+    if (job.chunks == NULL || job.hashes == NULL)
+    {
+        free(job.chunks);
+        free(job.hashes);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+
+    int ret;
+    if ((ret = zpack_split_cdr(block, block_size, count, job.chunks, chunk_count)) ||
+        (ret = zpack_reserve_file_index(&reader->file_index, count)))
+    {
+        free(job.chunks);
+        free(job.hashes);
+        return ret;
+    }
+    if ((size_t)thread_count > chunk_count) thread_count = (int)chunk_count;
+
+    // the index can only be built once every filename has been parsed
+    zpack_run_workers(zpack_parse_cdr_worker, &job, thread_count);
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        if ((ret = job.chunks[i].result))
+        {
+            free(job.chunks);
+            free(job.hashes);
+            return ret;
+        }
+    }
+
+    job.next = 0;
+    zpack_run_workers(zpack_index_cdr_worker, &job, thread_count);
+
+    // totals
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        reader->comp_size += job.chunks[i].comp_size;
+        reader->uncomp_size += job.chunks[i].uncomp_size;
+        reader->file_index.count += job.chunks[i].indexed;
+    }
+    reader->file_count = count;
+
+    free(job.chunks);
+    free(job.hashes);
+    return ZPACK_OK;
+}
+#endif // ZPACK_HAVE_PARALLEL_READ
+
+int zpack_read_cdr_parallel(zpack_reader* reader)
+{
+    int ret;
+    zpack_u8* block;
+    zpack_u64 count;
+    zpack_u64 block_size;
+    zpack_bool owned;
+    if ((ret = zpack_read_cdr_block(reader, &block, &count, &block_size, &owned)))
+        return ret;
+
+#ifdef ZPACK_HAVE_PARALLEL_READ
+    if (count >= ZPACK_PARALLEL_CDR_MIN_ENTRIES)
+        ret = zpack_parse_cdr_block(reader, block, count, block_size);
+    else
+#endif
+    {
+        // not worth splitting up
+        if (count) ret = zpack_read_file_entries_memory(block, &reader->file_entries, count, block_size,
+                                                        &reader->file_count, &reader->comp_size, &reader->uncomp_size);
+        if (!ret) ret = zpack_init_file_index(&reader->file_index, reader->file_entries, reader->file_count);
+    }
+
+    if (owned) free(block);
+    return ret;
+}
@@ -0,0 +1,233 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define ZPACK_PREFETCH_CHUNK_SIZE (1 << 20) // 1mb
+#define ZPACK_PREFETCH_PAGE_SIZE 4096       // stride used to touch mapped pages
+
+typedef struct zpack_prefetch_range_s
+{
+    zpack_u64 offset;
+    zpack_u64 size;
+
+} zpack_prefetch_range;
+
+static int zpack_compare_prefetch_ranges(const void* a, const void* b)
+{
+    zpack_u64 offset_a = ((const zpack_prefetch_range*)a)->offset;
+    zpack_u64 offset_b = ((const zpack_prefetch_range*)b)->offset;
+    return (offset_a > offset_b) - (offset_a < offset_b);
+}
+
+// gets the compressed data ranges of the entries, sorted and merged like zpack_read_files does
+static int zpack_get_prefetch_ranges(zpack_reader* reader, zpack_file_entry** entries, size_t count,
+                                     zpack_prefetch_range** ranges, size_t* range_count)
+{
+    *ranges = (zpack_prefetch_range*)malloc(sizeof(zpack_prefetch_range) * (count ? count : 1));
+    if (*ranges == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        zpack_file_entry* entry = entries[i];
+        if (entry->offset + entry->comp_size > reader->file_size)
+        {
+            free(*ranges);
+            return ZPACK_ERROR_FILE_OFFSET_INVALID;
+        }
+
+        if (!entry->comp_size) continue;
+        (*ranges)[n].offset = entry->offset;
+        (*ranges)[n].size = entry->comp_size;
+        ++n;
+    }
+    qsort(*ranges, n, sizeof(zpack_prefetch_range), zpack_compare_prefetch_ranges);
+
+    // merge ranges that overlap or are close to each other
+    size_t merged = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        zpack_prefetch_range* range = *ranges + i;
+        zpack_prefetch_range* last = merged ? *ranges + merged - 1 : NULL;
+        if (last && range->offset <= last->offset + last->size + ZPACK_READ_FILES_MAX_GAP)
+        {
+            zpack_u64 end = ZPACK_MAX(last->offset + last->size, range->offset + range->size);
+            last->size = end - last->offset;
+        }
+        else
+            (*ranges)[merged++] = *range;
+    }
+
+    *range_count = merged;
+    return ZPACK_OK;
+}
+
+// passes a hint to the kernel, does nothing if there's no way to do so
+static void zpack_advise_range(zpack_reader* reader, const zpack_prefetch_range* range, zpack_bool will_need)
+{
+#if defined(POSIX_FADV_WILLNEED)
+    if (reader->file)
+    {
+        posix_fadvise(fileno(reader->file), (off_t)range->offset, (off_t)range->size,
+                      will_need ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED);
+        return;
+    }
+#endif
+
+#if defined(MADV_WILLNEED)
+    if (reader->buffer_mapped)
+    {
+        // the mapping itself is page aligned, the range needs to be as well
+        zpack_u64 page_size = (zpack_u64)sysconf(_SC_PAGESIZE);
+        zpack_u64 start = range->offset & ~(page_size - 1);
+        madvise(reader->buffer + start, (size_t)(range->offset + range->size - start),
+                will_need ? MADV_WILLNEED : MADV_DONTNEED);
+    }
+#endif
+}
+
+#if defined(ZPACK_HAVE_THREADS) && defined(ZPACK_HAVE_ATOMICS)
+#define ZPACK_HAVE_BACKGROUND_PREFETCH
+
+typedef struct zpack_prefetcher_s
+{
+    zpack_reader* reader;
+    zpack_thread thread;
+    zpack_prefetch_range* ranges;
+    size_t range_count;
+    volatile zpack_u32 stop;
+
+} zpack_prefetcher;
+
+static void zpack_prefetcher_main(void* arg)
+{
+    zpack_prefetcher* prefetcher = (zpack_prefetcher*)arg;
+    zpack_reader* reader = prefetcher->reader;
+
+    // the data is read and thrown away, the page cache (or the fetch cache) keeps it around
+    zpack_u8* buffer = ZPACK_READER_HAS_IO(reader) ? (zpack_u8*)malloc(ZPACK_PREFETCH_CHUNK_SIZE) : NULL;
+    if (ZPACK_READER_HAS_IO(reader) && buffer == NULL) return;
+
+    volatile zpack_u8 sink = 0;
+    for (size_t i = 0; i < prefetcher->range_count; ++i)
+    {
+        zpack_u64 offset = prefetcher->ranges[i].offset;
+        zpack_u64 end = offset + prefetcher->ranges[i].size;
+        while (offset < end && !zpack_atomic_load_u32(&prefetcher->stop))
+        {
+            size_t size = (size_t)ZPACK_MIN(end - offset, ZPACK_PREFETCH_CHUNK_SIZE);
+            if (reader->fetch)
+            {
+                if (zpack_fetch_archive_at(reader, offset, buffer, size)) break;
+            }
+            else if (reader->file)
+            {
+                if (zpack_read_file_at(reader->file, offset, buffer, size)) break;
+            }
+            else
+            {
+                // touch every page of the mapping
+                for (size_t j = 0; j < size; j += ZPACK_PREFETCH_PAGE_SIZE)
+                    sink += reader->buffer[offset + j];
+            }
+            offset += size;
+        }
+    }
+
+    (void)sink;
+    free(buffer);
+}
+
+static int zpack_start_prefetcher(zpack_reader* reader, zpack_prefetch_range* ranges, size_t range_count)
+{
+    zpack_prefetcher* prefetcher = (zpack_prefetcher*)calloc(1, sizeof(zpack_prefetcher));
+    if (prefetcher == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    prefetcher->reader = reader;
+    prefetcher->ranges = ranges;
+    prefetcher->range_count = range_count;
+
+    int ret;
+    if ((ret = zpack_thread_create(&prefetcher->thread, zpack_prefetcher_main, prefetcher)))
+    {
+        free(prefetcher);
+        return ret;
+    }
+
+    reader->prefetcher = prefetcher;
+    return ZPACK_OK;
+}
+#endif // ZPACK_HAVE_BACKGROUND_PREFETCH
+
+int zpack_prefetch(zpack_reader* reader, zpack_file_entry** entries, size_t count, zpack_bool background)
+{
+    if (!ZPACK_READER_HAS_IO(reader) && !reader->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+
+    // the data of in-memory archives is already there
+    if (!ZPACK_READER_HAS_IO(reader) && !reader->buffer_mapped) return ZPACK_OK;
+
+    int ret;
+    zpack_prefetch_range* ranges;
+    size_t range_count;
+    if ((ret = zpack_get_prefetch_ranges(reader, entries, count, &ranges, &range_count)))
+        return ret;
+
+    for (size_t i = 0; i < range_count; ++i)
+        zpack_advise_range(reader, ranges + i, ZPACK_TRUE);
+
+#ifdef ZPACK_HAVE_BACKGROUND_PREFETCH
+    if (background && range_count)
+    {
+        // the previous prefetch is superseded by this one
+        zpack_free_prefetcher(reader);
+
+        // the ranges are freed by the prefetcher
+        if ((ret = zpack_start_prefetcher(reader, ranges, range_count)))
+            free(ranges);
+        return ret;
+    }
+#endif
+
+    free(ranges);
+    return ZPACK_OK;
+}
+
+int zpack_evict(zpack_reader* reader, zpack_file_entry** entries, size_t count)
+{
+    if (!ZPACK_READER_HAS_IO(reader) && !reader->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+    if (!reader->file && !reader->buffer_mapped) return ZPACK_OK;
+
+    int ret;
+    zpack_prefetch_range* ranges;
+    size_t range_count;
+    if ((ret = zpack_get_prefetch_ranges(reader, entries, count, &ranges, &range_count)))
+        return ret;
+
+    for (size_t i = 0; i < range_count; ++i)
+        zpack_advise_range(reader, ranges + i, ZPACK_FALSE);
+
+    free(ranges);
+    return ZPACK_OK;
+}
+
+void zpack_free_prefetcher(zpack_reader* reader)
+{
+#ifdef ZPACK_HAVE_BACKGROUND_PREFETCH
+    zpack_prefetcher* prefetcher = (zpack_prefetcher*)reader->prefetcher;
+    if (!prefetcher) return;
+
+    zpack_atomic_or_u32(&prefetcher->stop, 1);
+    zpack_thread_join(prefetcher->thread);
+    free(prefetcher->ranges);
+    free(prefetcher);
+#endif
+
+    reader->prefetcher = NULL;
+}
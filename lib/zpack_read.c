@@ -14,6 +14,12 @@
 #include <lz4frame.h>
 #endif
 
+// ZSTD_FRAMEHEADERSIZE_MAX, which is only exposed by the static API
+#define ZPACK_ZSTD_FRAME_HEADER_SIZE_MAX 18
+
+// first zstd version that supports in-place decompression (ZSTD_DECOMPRESSION_MARGIN)
+#define ZPACK_ZSTD_IN_PLACE_VERSION 10504
+
 #define ZPACK_CHECK_DCTX_ZSTD(dctx, reader) \
     if (!dctx) \
     { \
@@ -30,6 +36,90 @@
         dctx = reader->lz4f_dctx; \
     }
 
+#define ZPACK_READER_POSITIONAL(reader) (((reader)->flags & ZPACK_READER_POSITIONAL_IO) != 0)
+#define zpack_read_archive_at(reader, offset, buffer, size) \
+    zpack_read_archive_io(reader, offset, buffer, size, ZPACK_READER_POSITIONAL(reader))
+
+// reads data from the reader's file stream, using positional I/O if requested, or from the fetch callback
+static int zpack_read_archive_io(zpack_reader* reader, zpack_u64 offset, zpack_u8* buffer, size_t size,
+                                 zpack_bool positional)
+{
+    if (reader->fetch)
+        return zpack_fetch_archive_at(reader, offset, buffer, size);
+
+    if (positional)
+        return zpack_read_file_at(reader->file, offset, buffer, size);
+
+    if (ZPACK_FSEEK(reader->file, offset, SEEK_SET) != 0)
+        return ZPACK_ERROR_SEEK_FAILED;
+
+    if (ZPACK_FREAD(buffer, 1, size, reader->file) != size)
+        return ZPACK_ERROR_READ_FAILED;
+
+    return ZPACK_OK;
+}
+
+// records the compression library's return value, readers that can be read from several threads at once
+// only keep it where the store is atomic
+static void zpack_set_last_return(zpack_reader* reader, size_t value)
+{
+#ifdef ZPACK_HAVE_ATOMICS
+    zpack_atomic_store_size(&reader->last_return, value);
+#else
+    if (reader->file && !(reader->flags & ZPACK_READER_POSITIONAL_IO))
+        reader->last_return = value;
+#endif
+}
+
+// the CDR if it's already in memory: the reader's buffer, or the tail read while the archive is being opened
+static zpack_u8* zpack_get_cdr_memory(zpack_reader* reader)
+{
+    if (reader->cdr_buffer) return reader->cdr_buffer;
+    if (!reader->file && reader->buffer) return reader->buffer + reader->cdr_offset;
+    return NULL;
+}
+
+static void zpack_free_cdr_buffer(zpack_reader* reader)
+{
+    free(reader->cdr_buffer);
+    reader->cdr_buffer = NULL;
+}
+
+#ifdef ZPACK_HAVE_ATOMICS
+static int zpack_init_dctx_pools(zpack_reader* reader)
+{
+    if (reader->zstd_dctx_pool || reader->lz4f_dctx_pool) return ZPACK_OK;
+    if (!reader->dctx_pool_size) reader->dctx_pool_size = ZPACK_DEFAULT_DCTX_POOL_SIZE;
+
+    // contexts are created on demand and put into the pool when they're returned
+#ifndef ZPACK_DISABLE_ZSTD
+    reader->zstd_dctx_pool = (void* volatile*)calloc(reader->dctx_pool_size, sizeof(void*));
+    if (reader->zstd_dctx_pool == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+#endif
+
+#ifndef ZPACK_DISABLE_LZ4
+    reader->lz4f_dctx_pool = (void* volatile*)calloc(reader->dctx_pool_size, sizeof(void*));
+    if (reader->lz4f_dctx_pool == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+#endif
+
+    return ZPACK_OK;
+}
+#else
+// no atomics available, zpack_read_file falls back to the built-in contexts
+#define zpack_init_dctx_pools(reader) ZPACK_OK
+#endif
+
+static void zpack_free_dctx_pool(void* volatile* pool, size_t size, zpack_compression_method method)
+{
+    if (pool == NULL) return;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (pool[i]) zpack_free_dctx(method, pool[i]);
+    }
+    free((void*)pool);
+}
+
 int zpack_read_header_memory(const zpack_u8* buffer, zpack_u16* version)
 {
     if (!ZPACK_VERIFY_SIGNATURE(buffer, ZPACK_HEADER_SIGNATURE))
@@ -106,22 +196,16 @@ int zpack_read_cdr_header_memory(const zpack_u8* buffer, zpack_u64* count, zpack
     return ZPACK_OK;
 }
 
-int zpack_read_file_entry_memory(const zpack_u8* buffer, zpack_u64* size_left, zpack_file_entry* entry, size_t* entry_size)
+static int zpack_read_file_entry_fields(const zpack_u8* buffer, zpack_u64* size_left, zpack_file_entry* entry,
+                                        size_t* entry_size, zpack_u16* filename_len)
 {
-    // filename
-    zpack_u16 filename_len = ZPACK_READ_LE16(buffer);
-    *entry_size = ZPACK_FILE_ENTRY_FIXED_SIZE + filename_len;
+    *filename_len = ZPACK_READ_LE16(buffer);
+    *entry_size = ZPACK_FILE_ENTRY_FIXED_SIZE + *filename_len;
     if (*entry_size > *size_left)
         return ZPACK_ERROR_BLOCK_SIZE_INVALID;
     *size_left -= *entry_size;
 
-    entry->filename = (char*)malloc(sizeof(char) * ((zpack_u32)filename_len + 1)); // for null terminator
-    if (entry->filename == NULL) return ZPACK_ERROR_MALLOC_FAILED;
-    memcpy(entry->filename, buffer + 2, filename_len);
-    // null terminator
-    entry->filename[filename_len] = '\0';
-
-    buffer += 2 + filename_len;
+    buffer += 2 + *filename_len;
 
     // fixed fields
     entry->offset      = ZPACK_READ_LE64(buffer);
@@ -133,28 +217,45 @@ int zpack_read_file_entry_memory(const zpack_u8* buffer, zpack_u64* size_left, z
     return ZPACK_OK;
 }
 
-int zpack_read_file_entries_memory(const zpack_u8* buffer, zpack_file_entry** entries, zpack_u64 header_count,
-                                   zpack_u64 block_size, zpack_u64* count, zpack_u64* total_cs, zpack_u64* total_us)
+int zpack_read_file_entry_memory(const zpack_u8* buffer, zpack_u64* size_left, zpack_file_entry* entry, size_t* entry_size)
 {
-    // basic fixed size check
-    if (header_count * ZPACK_FILE_ENTRY_FIXED_SIZE > block_size)
-        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+    int ret;
+    zpack_u16 filename_len;
+    if ((ret = zpack_read_file_entry_fields(buffer, size_left, entry, entry_size, &filename_len)))
+        return ret;
 
-    zpack_u64 eb_size = sizeof(zpack_file_entry) * header_count;
-    if (eb_size > SIZE_MAX) return ZPACK_ERROR_MALLOC_FAILED;
-    *entries = (zpack_file_entry*)realloc(*entries, eb_size);
-    if (*entries == NULL) return ZPACK_ERROR_MALLOC_FAILED;
-    memset(*entries, 0, eb_size);
+    // filename
+    entry->filename = (char*)malloc(sizeof(char) * ((zpack_u32)filename_len + 1)); // for null terminator
+    if (entry->filename == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+    memcpy(entry->filename, buffer + 2, filename_len);
+    // null terminator
+    entry->filename[filename_len] = '\0';
 
-    // read file entries
+    return ZPACK_OK;
+}
+
+int zpack_parse_file_entries(const zpack_u8* buffer, zpack_u64 block_size, zpack_file_entry* entries, zpack_u64 count,
+                             char* arena, zpack_u64 arena_size, zpack_u64* parsed, zpack_u64* total_cs, zpack_u64* total_us)
+{
     int ret;
     size_t entry_size;
-    for (zpack_u64 i = 0; i < header_count; ++i)
+    zpack_u16 filename_len;
+    for (zpack_u64 i = 0; i < count; ++i)
     {
-        zpack_file_entry* entry = *entries + i;
-        if ((ret = zpack_read_file_entry_memory(buffer, &block_size, entry, &entry_size)))
+        zpack_file_entry* entry = entries + i;
+        if ((ret = zpack_read_file_entry_fields(buffer, &block_size, entry, &entry_size, &filename_len)))
             return ret;
-        ++(*count);
+
+        // filename
+        if ((zpack_u64)filename_len + 1 > arena_size)
+            return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+        memcpy(arena, buffer + 2, filename_len);
+        arena[filename_len] = '\0';
+        entry->filename = arena;
+        arena += filename_len + 1;
+        arena_size -= filename_len + 1;
+
+        ++(*parsed);
         *total_cs += entry->comp_size;
         *total_us += entry->uncomp_size;
 
@@ -165,6 +266,27 @@ int zpack_read_file_entries_memory(const zpack_u8* buffer, zpack_file_entry** en
     return ZPACK_OK;
 }
 
+int zpack_read_file_entries_memory(const zpack_u8* buffer, zpack_file_entry** entries, zpack_u64 header_count,
+                                   zpack_u64 block_size, zpack_u64* count, zpack_u64* total_cs, zpack_u64* total_us)
+{
+    // basic fixed size check
+    if (header_count > block_size / ZPACK_FILE_ENTRY_FIXED_SIZE)
+        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+    // the filenames are stored right after the entries in the same allocation
+    // (every byte of the block that isn't a fixed field + a null terminator for each filename)
+    zpack_u64 eb_size = sizeof(zpack_file_entry) * header_count;
+    zpack_u64 arena_size = block_size - header_count * ZPACK_FILE_ENTRY_FIXED_SIZE + header_count;
+    if (eb_size + arena_size > SIZE_MAX) return ZPACK_ERROR_MALLOC_FAILED;
+    *entries = (zpack_file_entry*)realloc(*entries, eb_size + arena_size);
+    if (*entries == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+    memset(*entries, 0, eb_size);
+
+    // read file entries
+    return zpack_parse_file_entries(buffer, block_size, *entries, header_count, (char*)(*entries + header_count),
+                                    arena_size, count, total_cs, total_us);
+}
+
 int zpack_read_cdr_memory(const zpack_u8* buffer, size_t size_left, zpack_file_entry** entries, zpack_u64* count,
                           zpack_u64* total_cs, zpack_u64* total_us)
 {
@@ -215,13 +337,142 @@ int zpack_read_cdr(FILE* fp, zpack_u64 cdr_offset, zpack_file_entry** entries, z
 
     // read and parse file entries
     if (!ZPACK_FREAD(fe_buffer, block_size, 1, fp))
+    {
+        free(fe_buffer);
         return ZPACK_ERROR_READ_FAILED;
+    }
     ret = zpack_read_file_entries_memory(fe_buffer, entries, file_count, block_size, count, total_cs, total_us);
 
     free(fe_buffer);
     return ret;
 }
 
+int zpack_read_cdr_block(zpack_reader* reader, zpack_u8** block, zpack_u64* count, zpack_u64* block_size,
+                         zpack_bool* owned)
+{
+    if (reader->cdr_offset + ZPACK_CDR_HEADER_SIZE > reader->file_size)
+        return ZPACK_ERROR_READ_FAILED;
+    zpack_u64 size_left = reader->file_size - reader->cdr_offset - ZPACK_CDR_HEADER_SIZE;
+
+    int ret;
+    zpack_u8* cdr = zpack_get_cdr_memory(reader);
+    if (cdr)
+    {
+        if ((ret = zpack_read_cdr_header_memory(cdr, count, block_size)))
+            return ret;
+        if (*block_size > size_left)
+            return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+        *block = cdr + ZPACK_CDR_HEADER_SIZE;
+        *owned = ZPACK_FALSE;
+        return ZPACK_OK;
+    }
+
+    zpack_u8 header[ZPACK_CDR_HEADER_SIZE];
+    if ((ret = zpack_read_archive_at(reader, reader->cdr_offset, header, ZPACK_CDR_HEADER_SIZE)) ||
+        (ret = zpack_read_cdr_header_memory(header, count, block_size)))
+        return ret;
+    if (*block_size > size_left)
+        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+    if (*block_size > SIZE_MAX - 1)
+        return ZPACK_ERROR_MALLOC_FAILED;
+
+    *block = (zpack_u8*)malloc((size_t)*block_size + 1);
+    if (*block == NULL)
+        return ZPACK_ERROR_MALLOC_FAILED;
+
+    if ((ret = zpack_read_archive_at(reader, reader->cdr_offset + ZPACK_CDR_HEADER_SIZE, *block, (size_t)*block_size)))
+    {
+        free(*block);
+        *block = NULL;
+        return ret;
+    }
+
+    *owned = ZPACK_TRUE;
+    return ZPACK_OK;
+}
+
+// reads the head and the tail of the archive, and keeps everything from the CDR to the end of the
+// file in reader->cdr_buffer
+static int zpack_read_archive_tail(zpack_reader* reader)
+{
+    if (!reader->tail_read_size) reader->tail_read_size = ZPACK_DEFAULT_TAIL_READ_SIZE;
+    size_t tail_size = (size_t)ZPACK_MIN((zpack_u64)ZPACK_MAX(reader->tail_read_size, ZPACK_EOCDR_SIZE),
+                                         reader->file_size);
+    zpack_u64 tail_offset = reader->file_size - tail_size;
+
+    int ret;
+    zpack_u8* tail = (zpack_u8*)malloc(tail_size);
+    if (tail == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+    if ((ret = zpack_read_archive_at(reader, tail_offset, tail, tail_size)))
+    {
+        free(tail);
+        return ret;
+    }
+
+    // the head only needs its own read if the window doesn't cover the whole file
+    zpack_u8 head_buffer[ZPACK_HEADER_SIZE + ZPACK_SIGNATURE_SIZE];
+    const zpack_u8* head = tail;
+    if (tail_offset)
+    {
+        if ((ret = zpack_read_archive_at(reader, 0, head_buffer, sizeof(head_buffer))))
+        {
+            free(tail);
+            return ret;
+        }
+        head = head_buffer;
+    }
+
+    // header, files data signature and eocdr
+    reader->eocdr_offset = reader->file_size - ZPACK_EOCDR_SIZE;
+    if ((ret = zpack_read_header_memory(head, &reader->version)) ||
+        (ret = zpack_read_data_header_memory(head + ZPACK_HEADER_SIZE)) ||
+        (ret = zpack_read_eocdr_memory(tail + tail_size - ZPACK_EOCDR_SIZE, &reader->cdr_offset)))
+    {
+        free(tail);
+        return ret;
+    }
+
+    if (reader->cdr_offset > reader->eocdr_offset)
+    {
+        free(tail);
+        return ZPACK_ERROR_READ_FAILED;
+    }
+
+    zpack_u64 cdr_size = reader->file_size - reader->cdr_offset;
+    if (reader->cdr_offset >= tail_offset)
+    {
+        // the whole CDR is in the window
+        memmove(tail, tail + (reader->cdr_offset - tail_offset), (size_t)cdr_size);
+        reader->cdr_buffer = tail;
+        return ZPACK_OK;
+    }
+
+    // the CDR is larger than the window, read the rest of it
+    if (cdr_size > SIZE_MAX)
+    {
+        free(tail);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+    zpack_u8* cdr = (zpack_u8*)realloc(tail, (size_t)cdr_size);
+    if (cdr == NULL)
+    {
+        free(tail);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+
+    size_t missing = (size_t)(tail_offset - reader->cdr_offset);
+    memmove(cdr + missing, cdr, tail_size);
+    if ((ret = zpack_read_archive_at(reader, reader->cdr_offset, cdr, missing)))
+    {
+        free(cdr);
+        return ret;
+    }
+
+    reader->cdr_buffer = cdr;
+    return ZPACK_OK;
+}
+
 int zpack_read_archive_memory(zpack_reader* reader)
 {
     if (!reader->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
@@ -229,6 +480,9 @@ int zpack_read_archive_memory(zpack_reader* reader)
 
     // read sections
     int ret;
+    if ((ret = zpack_init_dctx_pools(reader)) || (ret = zpack_init_cache(reader)))
+        return ret;
+
     const zpack_u8* p = reader->buffer;
 
     // header
@@ -249,139 +503,424 @@ int zpack_read_archive_memory(zpack_reader* reader)
     if (reader->cdr_offset >= reader->file_size)
         return ZPACK_ERROR_READ_FAILED;
 
-    // cdr
-    p = reader->buffer + reader->cdr_offset;
-    if ((ret = zpack_read_cdr_memory(p, reader->file_size - reader->cdr_offset, &reader->file_entries, &reader->file_count,
-                                     &reader->comp_size, &reader->uncomp_size)))
+    // compact entry table, mapped from the sidecar index when possible
+    if ((reader->flags & ZPACK_READER_ENTRY_TABLE) && (ret = zpack_load_entry_table(reader)))
+        return ret;
+
+    // cdr (read on demand)
+    if (reader->flags & ZPACK_READER_SKIP_FILE_ENTRIES)
+        return ZPACK_OK;
+
+    if (reader->parse_thread_count > 1)
+    {
+        // the entries and the filename index are built by multiple threads
+        if ((ret = zpack_read_cdr_parallel(reader)))
+            return ret;
+    }
+    else
+    {
+        p = reader->buffer + reader->cdr_offset;
+        if ((ret = zpack_read_cdr_memory(p, reader->file_size - reader->cdr_offset, &reader->file_entries,
+                                         &reader->file_count, &reader->comp_size, &reader->uncomp_size)))
+            return ret;
+
+        // filename lookup index
+        if ((ret = zpack_init_file_index(&reader->file_index, reader->file_entries, reader->file_count)))
+            return ret;
+    }
+
+    // directory tree
+    if ((reader->flags & ZPACK_READER_DIRECTORY_INDEX) &&
+        (ret = zpack_init_dir_index(&reader->dir_index, reader->file_entries, reader->file_count)))
         return ret;
 
-    // all good
-    return ZPACK_OK; 
+    // hash verification state
+    return zpack_init_verifier(reader);
 }
 
 int zpack_read_archive(zpack_reader* reader)
 {
-    if (!reader->file) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+    if (!ZPACK_READER_HAS_IO(reader)) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
 
-    // get size
-    if (ZPACK_FSEEK(reader->file, 0, SEEK_END) != 0)
-        return ZPACK_ERROR_SEEK_FAILED;
-    
-    if (!reader->file_size) reader->file_size = ZPACK_FTELL(reader->file);
+    // get size (fetch readers are given it)
+    if (reader->file)
+    {
+        if (ZPACK_FSEEK(reader->file, 0, SEEK_END) != 0)
+            return ZPACK_ERROR_SEEK_FAILED;
+
+        if (!reader->file_size) reader->file_size = ZPACK_FTELL(reader->file);
+    }
     if (reader->file_size < ZPACK_MINIMUM_ARCHIVE_SIZE) return ZPACK_ERROR_FILE_TOO_SMALL;
 
     // read sections
     int ret;
-
-    // header
-    if ((ret = zpack_read_header(reader->file, &reader->version)))
+    if ((ret = zpack_init_dctx_pools(reader)) || (ret = zpack_init_cache(reader)))
         return ret;
 
-    // files data signature
-    if ((ret = zpack_read_data_header(reader->file)))
-        return ret;
+#ifdef ZPACK_HAVE_IO_URING
+    // regular reads are used if the ring can't be set up
+    if ((reader->flags & ZPACK_READER_ASYNC_IO) && !reader->async_io)
+        zpack_uring_init((void**)&reader->async_io, ZPACK_ASYNC_IO_QUEUE_DEPTH);
+#endif
 
-    // eocdr
-    reader->eocdr_offset = reader->file_size - ZPACK_EOCDR_SIZE;
-    if ((ret = zpack_read_eocdr(reader->file, reader->eocdr_offset, &reader->cdr_offset)))
+    if (reader->flags & ZPACK_READER_TAIL_READ)
+    {
+        // header, eocdr and cdr in as few reads as possible
+        if ((ret = zpack_read_archive_tail(reader)))
+            return ret;
+    }
+    else
+    {
+        // header
+        if ((ret = zpack_read_header(reader->file, &reader->version)))
+            return ret;
+
+        // files data signature
+        if ((ret = zpack_read_data_header(reader->file)))
+            return ret;
+
+        // eocdr
+        reader->eocdr_offset = reader->file_size - ZPACK_EOCDR_SIZE;
+        if ((ret = zpack_read_eocdr(reader->file, reader->eocdr_offset, &reader->cdr_offset)))
+            return ret;
+    }
+
+    // compact entry table, mapped from the sidecar index when possible
+    if ((reader->flags & ZPACK_READER_ENTRY_TABLE) && (ret = zpack_load_entry_table(reader)))
         return ret;
 
-    // cdr
-    if ((ret = zpack_read_cdr(reader->file, reader->cdr_offset, &reader->file_entries, 
-                              &reader->file_count, &reader->comp_size, &reader->uncomp_size)))
+    // cdr (read on demand)
+    if (reader->flags & ZPACK_READER_SKIP_FILE_ENTRIES)
+    {
+        zpack_free_cdr_buffer(reader);
+        return ZPACK_OK;
+    }
+
+    if (reader->parse_thread_count > 1)
+    {
+        // the entries and the filename index are built by multiple threads
+        if ((ret = zpack_read_cdr_parallel(reader)))
+            return ret;
+    }
+    else
+    {
+        if (reader->cdr_buffer)
+            ret = zpack_read_cdr_memory(reader->cdr_buffer, reader->file_size - reader->cdr_offset, &reader->file_entries,
+                                        &reader->file_count, &reader->comp_size, &reader->uncomp_size);
+        else
+            ret = zpack_read_cdr(reader->file, reader->cdr_offset, &reader->file_entries,
+                                 &reader->file_count, &reader->comp_size, &reader->uncomp_size);
+        if (ret) return ret;
+
+        // filename lookup index
+        if ((ret = zpack_init_file_index(&reader->file_index, reader->file_entries, reader->file_count)))
+            return ret;
+    }
+
+    zpack_free_cdr_buffer(reader);
+
+    // directory tree
+    if ((reader->flags & ZPACK_READER_DIRECTORY_INDEX) &&
+        (ret = zpack_init_dir_index(&reader->dir_index, reader->file_entries, reader->file_count)))
         return ret;
 
-    // all good
-    return ZPACK_OK;
+    // hash verification state
+    return zpack_init_verifier(reader);
 }
 
-int zpack_read_raw_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size)
+int zpack_hash_cdr(zpack_reader* reader, zpack_u64* hash)
 {
-    // offset check
-    if (entry->offset + entry->comp_size > reader->file_size)
-        return ZPACK_ERROR_FILE_OFFSET_INVALID;
+    if (reader->cdr_offset > reader->eocdr_offset || reader->eocdr_offset > reader->file_size)
+        return ZPACK_ERROR_READ_FAILED;
+    zpack_u64 size = reader->eocdr_offset - reader->cdr_offset;
 
-    // shrink read size to max size
-    zpack_u64 read_size = ZPACK_MIN(max_size, entry->comp_size);
-    if (reader->file)
+    zpack_u8* cdr = zpack_get_cdr_memory(reader);
+    if (cdr)
     {
-        if (ZPACK_FSEEK(reader->file, entry->offset, SEEK_SET) != 0)
-            return ZPACK_ERROR_SEEK_FAILED;
-        
-        if (ZPACK_FREAD(buffer, 1, read_size, reader->file) != read_size)
-            return ZPACK_ERROR_READ_FAILED;
+        *hash = XXH3_64bits(cdr, (size_t)size);
+        return ZPACK_OK;
     }
-    else if (reader->buffer)
+    if (!ZPACK_READER_HAS_IO(reader)) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+
+    XXH3_state_t* state = XXH3_createState();
+    if (state == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    size_t buffer_size = (size_t)ZPACK_MIN(size, ZPACK_CDR_ITERATOR_DEFAULT_WINDOW_SIZE);
+    zpack_u8* buffer = (zpack_u8*)malloc(buffer_size ? buffer_size : 1);
+    if (buffer == NULL)
     {
-        // Note: This function just copies data from the already loaded buffer.
-        // It might be better to just read straight from the buffer itself if possible.
-        memcpy(buffer, reader->buffer + entry->offset, read_size);
+        XXH3_freeState(state);
+        return ZPACK_ERROR_MALLOC_FAILED;
     }
-    else
-        return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
 
+    XXH3_64bits_reset(state);
+    zpack_u64 offset = reader->cdr_offset;
+    while (size)
+    {
+        size_t read_size = (size_t)ZPACK_MIN(size, buffer_size);
+        int ret;
+        if ((ret = zpack_read_archive_at(reader, offset, buffer, read_size)))
+        {
+            free(buffer);
+            XXH3_freeState(state);
+            return ret;
+        }
+
+        XXH3_64bits_update(state, buffer, read_size);
+        offset += read_size;
+        size -= read_size;
+    }
+    *hash = XXH3_64bits_digest(state);
+
+    free(buffer);
+    XXH3_freeState(state);
     return ZPACK_OK;
 }
 
-int zpack_read_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size, void* dctx)
+int zpack_init_cdr_iterator(zpack_cdr_iterator* iterator, zpack_reader* reader, size_t window_size)
 {
-    if (entry->comp_size == 0) return ZPACK_OK;
-    if (max_size < entry->uncomp_size) return ZPACK_ERROR_BUFFER_TOO_SMALL;
+    memset(iterator, 0, sizeof(zpack_cdr_iterator));
+    iterator->reader = reader;
 
-    if (entry->offset + entry->comp_size >= reader->file_size)
-        return ZPACK_ERROR_FILE_OFFSET_INVALID;
+    if (reader->cdr_offset + ZPACK_CDR_HEADER_SIZE > reader->file_size)
+        return ZPACK_ERROR_READ_FAILED;
+    zpack_u64 size_left = reader->file_size - reader->cdr_offset - ZPACK_CDR_HEADER_SIZE;
 
-    // read the compressed data
-    zpack_u8* comp_data;
-    if (reader->file)
+    // read the header
+    int ret;
+    zpack_u64 block_size;
+    zpack_u8* cdr = zpack_get_cdr_memory(reader);
+    if (cdr)
     {
-        if (entry->comp_size > SIZE_MAX) return ZPACK_ERROR_MALLOC_FAILED;
-        comp_data = (zpack_u8*)malloc(sizeof(zpack_u8) * entry->comp_size);
-        if (comp_data == NULL) return ZPACK_ERROR_MALLOC_FAILED;
-        int ret;
-        if ((ret = zpack_read_raw_file(reader, entry, comp_data, entry->comp_size)))
+        if ((ret = zpack_read_cdr_header_memory(cdr, &iterator->count, &block_size)))
+            return ret;
+    }
+    else if (ZPACK_READER_HAS_IO(reader))
+    {
+        zpack_u8 buffer[ZPACK_CDR_HEADER_SIZE];
+        if ((ret = zpack_read_archive_at(reader, reader->cdr_offset, buffer, ZPACK_CDR_HEADER_SIZE)))
+            return ret;
+
+        if ((ret = zpack_read_cdr_header_memory(buffer, &iterator->count, &block_size)))
             return ret;
     }
-    else if (reader->buffer)
-        comp_data = reader->buffer + entry->offset;
     else
         return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
-    
+
+    // block size check
+    if (block_size > size_left || iterator->count > block_size / ZPACK_FILE_ENTRY_FIXED_SIZE)
+        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+    iterator->offset = reader->cdr_offset + ZPACK_CDR_HEADER_SIZE;
+    iterator->size_left = block_size;
+
+    if (!cdr)
+    {
+        // the window is filled on demand
+        if (window_size == 0) window_size = ZPACK_CDR_ITERATOR_DEFAULT_WINDOW_SIZE;
+        iterator->window_size = ZPACK_MAX(window_size, ZPACK_CDR_ITERATOR_MIN_WINDOW_SIZE);
+        iterator->window = (zpack_u8*)malloc(sizeof(zpack_u8) * iterator->window_size);
+        if (iterator->window == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+        iterator->window_owned = ZPACK_TRUE;
+    }
+    else
+    {
+        // the entire block is already in memory
+        iterator->window = cdr + ZPACK_CDR_HEADER_SIZE;
+        iterator->window_size = iterator->window_len = (size_t)block_size;
+        iterator->offset += block_size;
+    }
+
+    return ZPACK_OK;
+}
+
+// makes sure that at least `needed` bytes are available in the window
+static int zpack_fill_cdr_iterator_window(zpack_cdr_iterator* iterator, size_t needed)
+{
+    size_t avail = iterator->window_len - iterator->window_pos;
+    if (avail >= needed) return ZPACK_OK;
+
+    // data that hasn't been read into the window yet
+    zpack_u64 unread = iterator->size_left - avail;
+    if (!iterator->window_owned || unread < needed - avail)
+        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+    // move the partial entry to the start of the window and read the next part of the block
+    memmove(iterator->window, iterator->window + iterator->window_pos, avail);
+    iterator->window_pos = 0;
+    iterator->window_len = avail;
+
+    int ret;
+    size_t read_size = (size_t)ZPACK_MIN(unread, iterator->window_size - avail);
+    if ((ret = zpack_read_archive_at(iterator->reader, iterator->offset, iterator->window + avail, read_size)))
+        return ret;
+
+    iterator->offset += read_size;
+    iterator->window_len += read_size;
+    return ZPACK_OK;
+}
+
+int zpack_next_cdr_entry(zpack_cdr_iterator* iterator, zpack_file_entry* entry)
+{
+    if (ZPACK_CDR_ITERATOR_DONE(iterator))
+        return ZPACK_ERROR_FILE_NOT_FOUND;
+
+    // filename length
+    int ret;
+    if ((ret = zpack_fill_cdr_iterator_window(iterator, 2)))
+        return ret;
+    zpack_u16 filename_len = ZPACK_READ_LE16(iterator->window + iterator->window_pos);
+
+    // entire entry
+    if ((ret = zpack_fill_cdr_iterator_window(iterator, ZPACK_FILE_ENTRY_FIXED_SIZE + filename_len)))
+        return ret;
+
+    size_t entry_size;
+    const zpack_u8* p = iterator->window + iterator->window_pos;
+    if ((ret = zpack_read_file_entry_fields(p, &iterator->size_left, entry, &entry_size, &filename_len)))
+        return ret;
+
+    // filename
+    if (iterator->filename_capacity < (size_t)filename_len + 1)
+    {
+        char* filename = (char*)realloc(iterator->filename, sizeof(char) * ((size_t)filename_len + 1));
+        if (filename == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+        iterator->filename = filename;
+        iterator->filename_capacity = (size_t)filename_len + 1;
+    }
+    memcpy(iterator->filename, p + 2, filename_len);
+    iterator->filename[filename_len] = '\0';
+    entry->filename = iterator->filename;
+
+    iterator->window_pos += entry_size;
+    ++iterator->index;
+    return ZPACK_OK;
+}
+
+void zpack_close_cdr_iterator(zpack_cdr_iterator* iterator)
+{
+    if (iterator->window_owned)
+        free(iterator->window);
+
+    free(iterator->filename);
+    memset(iterator, 0, sizeof(zpack_cdr_iterator));
+}
+
+static int zpack_read_raw_file_io(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size,
+                                  zpack_bool positional)
+{
+    // offset check
+    if (entry->offset + entry->comp_size > reader->file_size)
+        return ZPACK_ERROR_FILE_OFFSET_INVALID;
+
+    // shrink read size to max size
+    zpack_u64 read_size = ZPACK_MIN(max_size, entry->comp_size);
+    if (ZPACK_READER_HAS_IO(reader))
+    {
+        int ret;
+        if ((ret = zpack_read_archive_io(reader, entry->offset, buffer, (size_t)read_size, positional)))
+            return ret;
+    }
+    else if (reader->buffer)
+    {
+        // Note: This function just copies data from the already loaded buffer.
+        // It might be better to just read straight from the buffer itself if possible.
+        memcpy(buffer, reader->buffer + entry->offset, read_size);
+    }
+    else
+        return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+
+    return ZPACK_OK;
+}
+
+int zpack_read_raw_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size)
+{
+    return zpack_read_raw_file_io(reader, entry, buffer, max_size, ZPACK_READER_POSITIONAL(reader));
+}
+
+static void* volatile* zpack_get_dctx_pool(zpack_reader* reader, zpack_compression_method method)
+{
+    switch (method)
+    {
+    case ZPACK_COMPRESSION_ZSTD: return reader->zstd_dctx_pool;
+    case ZPACK_COMPRESSION_LZ4:  return reader->lz4f_dctx_pool;
+    default: return NULL;
+    }
+}
+
+#ifdef ZPACK_HAVE_ATOMICS
+// takes a context out of the pool, or creates a new one if the pool is empty
+static void* zpack_checkout_dctx(zpack_reader* reader, zpack_compression_method method)
+{
+    void* volatile* pool = zpack_get_dctx_pool(reader, method);
+    if (pool)
+    {
+        for (size_t i = 0; i < reader->dctx_pool_size; ++i)
+        {
+            if (zpack_atomic_load_ptr(pool + i) == NULL) continue;
+
+            void* dctx = zpack_atomic_exchange_ptr(pool + i, NULL);
+            if (dctx) return dctx;
+        }
+    }
+
+    return zpack_create_dctx(method);
+}
+
+// puts a context back into the pool, or frees it if the pool is full
+static void zpack_return_dctx(zpack_reader* reader, zpack_compression_method method, void* dctx)
+{
+    void* volatile* pool = zpack_get_dctx_pool(reader, method);
+    if (pool)
+    {
+        for (size_t i = 0; i < reader->dctx_pool_size; ++i)
+        {
+            if (zpack_atomic_load_ptr(pool + i) == NULL && zpack_atomic_cas_ptr(pool + i, NULL, dctx))
+                return;
+        }
+    }
+
+    zpack_free_dctx(method, dctx);
+}
+
+// reads without a context borrow one from the pool if the reader has one, and use the reader's own otherwise
+#define ZPACK_USE_DCTX_POOL(reader, method) (zpack_get_dctx_pool(reader, method) != NULL)
+#else
+// no pool without atomics, every read without a context creates its own so that concurrent reads
+// don't share the reader's
+#define ZPACK_USE_DCTX_POOL(reader, method) ZPACK_TRUE
+#define zpack_checkout_dctx(reader, method) zpack_create_dctx(method)
+#define zpack_return_dctx(reader, method, dctx) zpack_free_dctx(method, dctx)
+#endif
+
+// decompresses the entire file from a buffer containing its compressed data
+static int zpack_decompress_file(zpack_reader* reader, zpack_file_entry* entry, const zpack_u8* comp_data,
+                                 zpack_u8* buffer, size_t max_size, void* dctx, zpack_bool verify)
+{
     switch (entry->comp_method)
     {
     case ZPACK_COMPRESSION_NONE:
         // reading less than the compressed size is allowed
         if (entry->uncomp_size > entry->comp_size)
-        {
-            if (reader->file) free(comp_data);
             return ZPACK_ERROR_FILE_SIZE_INVALID;
-        }
 
         if (max_size < entry->uncomp_size)
-        {
-            if (reader->file) free(comp_data);
             return ZPACK_ERROR_BUFFER_TOO_SMALL;
-        }
 
         memcpy(buffer, comp_data, entry->uncomp_size);
-        if (reader->file) free(comp_data);
         break;
 
     case ZPACK_COMPRESSION_ZSTD:
     #ifndef ZPACK_DISABLE_ZSTD
         ZPACK_CHECK_DCTX_ZSTD(dctx, reader);
-        if (!dctx)
-        {
-            if (reader->file) free(comp_data);
-            return ZPACK_ERROR_MALLOC_FAILED;
-        }
-        
-        // and decompress the file
-        reader->last_return = ZSTD_decompressDCtx(dctx, buffer, max_size, comp_data, entry->comp_size);
-        if (reader->file) free(comp_data);
+        if (!dctx) return ZPACK_ERROR_MALLOC_FAILED;
+
+        // decompress the file
+        size_t result = ZSTD_decompressDCtx(dctx, buffer, max_size, comp_data, entry->comp_size);
+        zpack_set_last_return(reader, result);
 
         // check for errors
-        if (ZSTD_isError(reader->last_return))
+        if (ZSTD_isError(result))
         {
             ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
             return ZPACK_ERROR_DECOMPRESS_FAILED;
@@ -389,7 +928,6 @@ int zpack_read_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buf
 
         break;
     #else
-        if (reader->file) free(comp_data);
         return ZPACK_ERROR_NOT_AVAILABLE;
     #endif
     
@@ -397,12 +935,8 @@ int zpack_read_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buf
     #ifndef ZPACK_DISABLE_LZ4
     {
         ZPACK_CHECK_DCTX_LZ4(dctx, reader);
-        if (!dctx)
-        {
-            if (reader->file) free(comp_data);
-            return ZPACK_ERROR_MALLOC_FAILED;
-        }
-        
+        if (!dctx) return ZPACK_ERROR_MALLOC_FAILED;
+
         zpack_u8* dst = buffer;
         const zpack_u8* src = comp_data;
 
@@ -410,17 +944,17 @@ int zpack_read_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buf
         size_t avail_in  = entry->comp_size;
 
         // decompress the file
-        size_t dst_size, src_size;
-        while (avail_out > 0 && avail_in > 0)
+        size_t dst_size, src_size, result = 0;
+        while (avail_in > 0)
         {
             dst_size = avail_out;
             src_size = avail_in;
 
-            reader->last_return = LZ4F_decompress(dctx, dst, &dst_size, src, &src_size, NULL);
+            result = LZ4F_decompress(dctx, dst, &dst_size, src, &src_size, NULL);
+            zpack_set_last_return(reader, result);
 
-            if (LZ4F_isError(reader->last_return))
+            if (LZ4F_isError(result))
             {
-                if (reader->file) free(comp_data);
                 LZ4F_resetDecompressionContext(dctx);
                 return ZPACK_ERROR_DECOMPRESS_FAILED;
             }
@@ -436,11 +970,13 @@ int zpack_read_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buf
                 dst += dst_size;
                 avail_out -= dst_size;
             }
+
+            // the output buffer is full (the frame's end mark can still be consumed with no space left)
+            if (!src_size && !dst_size) break;
         }
-        if (reader->file) free(comp_data);
 
         // check if the decompression is complete
-        if (reader->last_return != 0)
+        if (result != 0)
         {
             LZ4F_resetDecompressionContext(dctx);
             if (avail_out > 0)
@@ -452,21 +988,475 @@ int zpack_read_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buf
         break;
     }
     #else
-        if (reader->file) free(comp_data);
         return ZPACK_ERROR_NOT_AVAILABLE;
     #endif
 
-    default:
-        if (reader->file) free(comp_data);
-        return ZPACK_ERROR_COMP_METHOD_INVALID;
+    default:
+        return ZPACK_ERROR_COMP_METHOD_INVALID;
+
+    }
+
+    // verify hash
+    if (verify && XXH3_64bits(buffer, entry->uncomp_size) != entry->hash)
+        return ZPACK_ERROR_FILE_HASH_MISMATCH;
+
+    return ZPACK_OK;
+}
+
+// same as zpack_decompress_file, but borrows a decompression context from the pool if none was provided
+static int zpack_decompress_file_pooled(zpack_reader* reader, zpack_file_entry* entry, const zpack_u8* comp_data,
+                                        zpack_u8* buffer, size_t max_size, void* dctx, zpack_bool verify)
+{
+    void* pooled_dctx = NULL;
+    if (!dctx && entry->comp_method != ZPACK_COMPRESSION_NONE && ZPACK_USE_DCTX_POOL(reader, entry->comp_method))
+    {
+        if ((dctx = pooled_dctx = zpack_checkout_dctx(reader, entry->comp_method)) == NULL)
+            return ZPACK_ERROR_MALLOC_FAILED;
+    }
+
+    int ret = zpack_decompress_file(reader, entry, comp_data, buffer, max_size, dctx, verify);
+
+    if (pooled_dctx) zpack_return_dctx(reader, entry->comp_method, pooled_dctx);
+    return ret;
+}
+
+static int zpack_check_file_read(zpack_reader* reader, zpack_file_entry* entry, size_t max_size)
+{
+    if (max_size < entry->uncomp_size) return ZPACK_ERROR_BUFFER_TOO_SMALL;
+
+    if (entry->offset + entry->comp_size >= reader->file_size)
+        return ZPACK_ERROR_FILE_OFFSET_INVALID;
+
+    return ZPACK_OK;
+}
+
+size_t zpack_get_in_place_size(zpack_file_entry* entry)
+{
+    switch (entry->comp_method)
+    {
+    case ZPACK_COMPRESSION_NONE:
+        return (size_t)entry->uncomp_size;
+
+    #ifndef ZPACK_DISABLE_ZSTD
+    case ZPACK_COMPRESSION_ZSTD:
+    #if ZSTD_VERSION_NUMBER >= ZPACK_ZSTD_IN_PLACE_VERSION
+    {
+        // the library loaded at runtime can be older than the headers
+        if (ZSTD_versionNumber() < ZPACK_ZSTD_IN_PLACE_VERSION)
+            return 0;
+
+        // ZSTD_DECOMPRESSION_MARGIN: the frame header, the checksum, 3 bytes per block and one block,
+        // no block can be larger than the file itself
+        zpack_u64 block_size = ZPACK_MIN(entry->uncomp_size, ZSTD_BLOCKSIZE_MAX);
+        zpack_u64 block_count = block_size ? (entry->uncomp_size + block_size - 1) / block_size : 0;
+        zpack_u64 size = entry->uncomp_size + ZPACK_ZSTD_FRAME_HEADER_SIZE_MAX + 4 + 3 * block_count + block_size;
+        return (size > SIZE_MAX) ? 0 : (size_t)size;
+    }
+    #else
+        return 0;
+    #endif
+    #endif
+
+    // the LZ4 frame format has no documented in-place margin
+    default:
+        return 0;
+    }
+}
+
+static int zpack_read_file_internal(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size,
+                                    void* dctx, zpack_scratch* scratch, zpack_bool verify, zpack_bool positional)
+{
+    if (entry->comp_size == 0) return ZPACK_OK;
+
+    int ret;
+    if ((ret = zpack_check_file_read(reader, entry, max_size)))
+        return ret;
+
+    // read the compressed data
+    const zpack_u8* comp_data;
+    if (ZPACK_READER_HAS_IO(reader))
+    {
+        // stored files can be read straight into the output buffer
+        if (entry->comp_method == ZPACK_COMPRESSION_NONE)
+        {
+            if (entry->uncomp_size > entry->comp_size)
+                return ZPACK_ERROR_FILE_SIZE_INVALID;
+
+            if ((ret = zpack_read_archive_io(reader, entry->offset, buffer, (size_t)entry->uncomp_size, positional)))
+                return ret;
+
+            if (verify && XXH3_64bits(buffer, entry->uncomp_size) != entry->hash)
+                return ZPACK_ERROR_FILE_HASH_MISMATCH;
+
+            return ZPACK_OK;
+        }
+
+        if (entry->comp_size > SIZE_MAX) return ZPACK_ERROR_MALLOC_FAILED;
+
+        // with enough margin, the compressed data is read into the end of the output buffer and
+        // decompressed in place, otherwise it goes through the scratch buffer
+        size_t in_place_size = zpack_get_in_place_size(entry);
+        if (in_place_size && max_size >= in_place_size && max_size >= entry->comp_size)
+            comp_data = buffer + (max_size - (size_t)entry->comp_size);
+        else
+        {
+            if ((ret = zpack_check_and_grow_heap(&scratch->buffer, &scratch->capacity, entry->comp_size)))
+                return ret;
+
+            comp_data = scratch->buffer;
+        }
+
+        if ((ret = zpack_read_raw_file_io(reader, entry, (zpack_u8*)comp_data, entry->comp_size, positional)))
+            return ret;
+    }
+    else if (reader->buffer)
+        comp_data = reader->buffer + entry->offset;
+    else
+        return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+
+    return zpack_decompress_file_pooled(reader, entry, comp_data, buffer, max_size, dctx, verify);
+}
+
+int zpack_read_file_io(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size,
+                       void* dctx, zpack_scratch* scratch, zpack_bool positional)
+{
+    // check the verification policy
+    int ret;
+    zpack_bool verify;
+    if ((ret = zpack_begin_verify(reader, entry, &verify)))
+        return ret;
+
+    if ((ret = zpack_read_file_internal(reader, entry, buffer, max_size, dctx, scratch, verify, positional)))
+        return ret;
+
+    if (verify) zpack_end_verify(reader, entry);
+    return ZPACK_OK;
+}
+
+int zpack_read_file_scratch(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size,
+                            void* dctx, zpack_scratch* scratch)
+{
+    return zpack_read_file_io(reader, entry, buffer, max_size, dctx, scratch, ZPACK_READER_POSITIONAL(reader));
+}
+
+int zpack_read_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8* buffer, size_t max_size, void* dctx)
+{
+    // the reader's scratch buffer can't be shared by concurrent reads
+    if (reader->flags & ZPACK_READER_POSITIONAL_IO)
+    {
+        zpack_scratch scratch = { NULL, 0 };
+        int ret = zpack_read_file_scratch(reader, entry, buffer, max_size, dctx, &scratch);
+        zpack_free_scratch(&scratch);
+        return ret;
+    }
+
+    return zpack_read_file_scratch(reader, entry, buffer, max_size, dctx, &reader->scratch);
+}
+
+int zpack_compare_read_requests(const void* a, const void* b)
+{
+    zpack_u64 offset_a = (*(const zpack_read_request**)a)->entry->offset;
+    zpack_u64 offset_b = (*(const zpack_read_request**)b)->entry->offset;
+    return (offset_a > offset_b) - (offset_a < offset_b);
+}
+
+// decompresses a file from data that has already been read, following the verification policy
+static int zpack_read_file_from(zpack_reader* reader, zpack_read_request* request, const zpack_u8* comp_data)
+{
+    int ret;
+    zpack_bool verify;
+    if ((ret = zpack_begin_verify(reader, request->entry, &verify)))
+        return ret;
+
+    if ((ret = zpack_decompress_file_pooled(reader, request->entry, comp_data, request->buffer, request->max_size,
+                                            NULL, verify)))
+        return ret;
+
+    if (verify) zpack_end_verify(reader, request->entry);
+    return ZPACK_OK;
+}
+
+// finds the files following order[i] that can be read along with it, returns the index after the last one
+static size_t zpack_next_read_range(zpack_read_request** order, size_t i, size_t count, zpack_u64* start,
+                                    zpack_u64* end)
+{
+    *start = order[i]->entry->offset;
+    *end = *start + order[i]->entry->comp_size;
+
+    // extend the range with the following files as long as the gaps between them are small
+    size_t j = i + 1;
+    for (; j < count; ++j)
+    {
+        zpack_file_entry* entry = order[j]->entry;
+        zpack_u64 entry_end = ZPACK_MAX(*end, entry->offset + entry->comp_size);
+        if (entry->offset > *end + ZPACK_READ_FILES_MAX_GAP || entry_end - *start > ZPACK_READ_FILES_MAX_RANGE)
+            break;
+
+        *end = entry_end;
+    }
+
+    return j;
+}
+
+static int zpack_read_files_internal(zpack_reader* reader, zpack_read_request** order, size_t count,
+                                     zpack_scratch* scratch)
+{
+    int ret;
+    size_t i = 0;
+    while (i < count)
+    {
+        zpack_u64 start, end;
+        size_t j = zpack_next_read_range(order, i, count, &start, &end);
+
+        // read the range
+        const zpack_u8* data;
+        if (ZPACK_READER_HAS_IO(reader))
+        {
+            if (end - start > SIZE_MAX) return ZPACK_ERROR_MALLOC_FAILED;
+            if ((ret = zpack_check_and_grow_heap(&scratch->buffer, &scratch->capacity, end - start)))
+                return ret;
+
+            if ((ret = zpack_read_archive_at(reader, start, scratch->buffer, (size_t)(end - start))))
+            {
+                for (; i < j; ++i) order[i]->result = ret;
+                continue;
+            }
+
+            data = scratch->buffer;
+        }
+        else
+            data = reader->buffer + start;
+
+        // then decompress the files in it
+        for (; i < j; ++i)
+            order[i]->result = zpack_read_file_from(reader, order[i], data + (order[i]->entry->offset - start));
+    }
+
+    return ZPACK_OK;
+}
+
+#ifdef ZPACK_HAVE_IO_URING
+typedef struct zpack_async_read_s
+{
+    size_t first; // requests in the range
+    size_t last;
+    zpack_u64 start;
+    zpack_u64 size; // 0 if the slot is free
+    zpack_u64 done;
+    zpack_scratch scratch;
+
+} zpack_async_read;
+
+// same as zpack_read_files_internal, but keeps multiple ranges in flight and decompresses
+// the files of each range as soon as it has been read. The ring is freed if it fails
+static int zpack_read_files_async(zpack_reader* reader, zpack_read_request** order, size_t count, void** ring)
+{
+    size_t depth = ZPACK_MIN(zpack_uring_entries(*ring), ZPACK_ASYNC_IO_QUEUE_DEPTH);
+    zpack_async_read* slots = (zpack_async_read*)calloc(depth, sizeof(zpack_async_read));
+    if (slots == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    int ret = ZPACK_OK;
+    size_t i = 0;
+    size_t in_flight = 0;
+    zpack_u64 in_flight_size = 0;
+    while (i < count || in_flight)
+    {
+        // queue reads until the queue or the size limit is reached
+        while (i < count && in_flight < depth)
+        {
+            zpack_u64 start, end;
+            size_t j = zpack_next_read_range(order, i, count, &start, &end);
+            if (in_flight && in_flight_size + (end - start) > ZPACK_ASYNC_IO_MAX_IN_FLIGHT)
+                break;
+
+            size_t index = 0;
+            while (slots[index].size) ++index;
+            zpack_async_read* slot = slots + index;
+
+            int err = (end - start > SIZE_MAX) ? ZPACK_ERROR_MALLOC_FAILED :
+                      zpack_check_and_grow_heap(&slot->scratch.buffer, &slot->scratch.capacity, end - start);
+            if (!err)
+                err = zpack_uring_queue_read(*ring, reader->file, slot->scratch.buffer, (size_t)(end - start), start, index);
+
+            if (err)
+            {
+                for (; i < j; ++i) order[i]->result = err;
+                continue;
+            }
+
+            slot->first = i;
+            slot->last = j;
+            slot->start = start;
+            slot->size = end - start;
+            slot->done = 0;
+            ++in_flight;
+            in_flight_size += slot->size;
+            i = j;
+        }
+        if (!in_flight) continue;
+
+        zpack_u64 index;
+        int res;
+        if ((ret = zpack_uring_wait(*ring, &index, &res)))
+        {
+            // the kernel keeps writing into the buffers of the reads in flight until they complete, even after
+            // the ring is closed. Cancel them (the cancellations complete with an index past the slots) and
+            // wait for their completions before the buffers can be freed
+            for (size_t k = 0; k < depth; ++k)
+            {
+                if (!slots[k].size) continue;
+                for (size_t l = slots[k].first; l < slots[k].last; ++l)
+                    order[l]->result = ret;
+
+                zpack_uring_queue_cancel(*ring, k, depth);
+            }
+
+            while (in_flight && zpack_uring_wait(*ring, &index, &res) == ZPACK_OK)
+            {
+                if (index >= depth) continue;
+                slots[index].size = 0;
+                --in_flight;
+            }
+
+            // if that failed too, the buffers that might still be written to are leaked instead
+            for (size_t k = 0; k < depth && in_flight; ++k)
+            {
+                if (slots[k].size) slots[k].scratch.buffer = NULL;
+            }
+
+            zpack_uring_free(*ring);
+            *ring = NULL;
+            break;
+        }
+
+        zpack_async_read* slot = slots + index;
+        int err = ZPACK_OK;
+        if (res <= 0)
+            err = ZPACK_ERROR_READ_FAILED;
+        else if ((slot->done += res) < slot->size)
+        {
+            // short read, queue the rest of the range
+            if (!(err = zpack_uring_queue_read(*ring, reader->file, slot->scratch.buffer + slot->done,
+                                               (size_t)(slot->size - slot->done), slot->start + slot->done, index)))
+                continue;
+        }
+
+        for (size_t k = slot->first; k < slot->last; ++k)
+        {
+            order[k]->result = err ? err :
+                zpack_read_file_from(reader, order[k], slot->scratch.buffer + (order[k]->entry->offset - slot->start));
+        }
+
+        --in_flight;
+        in_flight_size -= slot->size;
+        slot->size = 0;
+    }
+
+    for (size_t k = 0; k < depth; ++k)
+        zpack_free_scratch(&slots[k].scratch);
+    free(slots);
+
+    return ret;
+}
+#endif
+
+int zpack_read_files(zpack_reader* reader, zpack_read_request* requests, size_t count)
+{
+    if (!ZPACK_READER_HAS_IO(reader) && !reader->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+    if (count == 0) return ZPACK_OK;
+
+    zpack_read_request** order = (zpack_read_request**)malloc(sizeof(zpack_read_request*) * count);
+    if (order == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    // validate the requests, files that can't be read are left out
+    size_t order_count = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        zpack_read_request* request = requests + i;
+        request->result = request->entry->comp_size ? zpack_check_file_read(reader, request->entry, request->max_size) :
+                                                      ZPACK_OK;
+
+        if (request->result == ZPACK_OK && request->entry->comp_size)
+            order[order_count++] = request;
+    }
+
+    // read in the order that the files are stored in
+    qsort(order, order_count, sizeof(zpack_read_request*), zpack_compare_read_requests);
+
+    int ret;
+#ifdef ZPACK_HAVE_IO_URING
+    // the ring can only be used by one thread at a time, others fall back to the regular reads
+    void* ring = reader->file ? zpack_atomic_exchange_ptr(&reader->async_io, NULL) : NULL;
+    if (ring)
+    {
+        ret = zpack_read_files_async(reader, order, order_count, &ring);
+        if (ring) zpack_atomic_exchange_ptr(&reader->async_io, ring);
+    }
+    else
+#endif
+    if (reader->flags & ZPACK_READER_POSITIONAL_IO)
+    {
+        // the reader's scratch buffer can't be shared by concurrent reads
+        zpack_scratch scratch = { NULL, 0 };
+        ret = zpack_read_files_internal(reader, order, order_count, &scratch);
+        zpack_free_scratch(&scratch);
+    }
+    else
+        ret = zpack_read_files_internal(reader, order, order_count, &reader->scratch);
+
+    free(order);
+    if (ret) return ret;
+
+    // report the first error
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (requests[i].result)
+            return requests[i].result;
+    }
+
+    return ZPACK_OK;
+}
+
+int zpack_verify_file(zpack_reader* reader, zpack_file_entry* entry, zpack_u8** buffer, size_t* capacity,
+                      zpack_scratch* scratch)
+{
+    int ret;
+    if (entry->uncomp_size > SIZE_MAX) return ZPACK_ERROR_MALLOC_FAILED;
+    if ((ret = zpack_check_and_grow_heap(buffer, capacity, ZPACK_MAX(entry->uncomp_size, 1))))
+        return ret;
+
+    return zpack_read_file_internal(reader, entry, *buffer, (size_t)entry->uncomp_size, NULL, scratch, ZPACK_TRUE,
+                                    ZPACK_READER_POSITIONAL(reader));
+}
 
-    }
+void zpack_free_scratch(zpack_scratch* scratch)
+{
+    free(scratch->buffer);
+    scratch->buffer = NULL;
+    scratch->capacity = 0;
+}
 
-    // verify hash
-    XXH64_hash_t hash = XXH3_64bits(buffer, entry->uncomp_size);
-    if (hash != entry->hash)
+int zpack_get_file_view(zpack_reader* reader, zpack_file_entry* entry, const zpack_u8** data, size_t* size,
+                        zpack_bool verify)
+{
+    if (!reader->buffer) return ZPACK_READER_HAS_IO(reader) ? ZPACK_ERROR_NOT_AVAILABLE : ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+    if (entry->comp_method != ZPACK_COMPRESSION_NONE) return ZPACK_ERROR_COMP_METHOD_INVALID;
+
+    // reading less than the compressed size is allowed
+    if (entry->uncomp_size > entry->comp_size)
+        return ZPACK_ERROR_FILE_SIZE_INVALID;
+
+    if (entry->comp_size && entry->offset + entry->comp_size >= reader->file_size)
+        return ZPACK_ERROR_FILE_OFFSET_INVALID;
+
+    if (entry->uncomp_size > SIZE_MAX) return ZPACK_ERROR_FILE_SIZE_INVALID;
+
+    const zpack_u8* p = reader->buffer + entry->offset;
+    if (verify && XXH3_64bits(p, entry->uncomp_size) != entry->hash)
         return ZPACK_ERROR_FILE_HASH_MISMATCH;
 
+    *data = p;
+    *size = (size_t)entry->uncomp_size;
     return ZPACK_OK;
 }
 
@@ -486,13 +1476,11 @@ int zpack_read_raw_file_stream(zpack_reader* reader, zpack_file_entry* entry, zp
     size_t offset = entry->offset + stream->total_in;
 
     // read the compressed data
-    if (reader->file)
+    if (ZPACK_READER_HAS_IO(reader))
     {
-        if (ZPACK_FSEEK(reader->file, offset, SEEK_SET) != 0)
-            return ZPACK_ERROR_SEEK_FAILED;
-        
-        if (ZPACK_FREAD(stream->next_in, 1, read_size, reader->file) != read_size)
-            return ZPACK_ERROR_READ_FAILED;
+        int ret;
+        if ((ret = zpack_read_archive_at(reader, offset, stream->next_in, read_size)))
+            return ret;
     }
     else if (reader->buffer)
         memcpy(stream->next_in, reader->buffer + offset, read_size);
@@ -520,9 +1508,15 @@ int zpack_read_file_stream(zpack_reader* reader, zpack_file_entry* entry, zpack_
     if (!stream->next_out || !stream->avail_out)
         return ZPACK_ERROR_STREAM_INVALID;
     
-    // reset xxh3 state at start
+    // check the verification policy and reset xxh3 state at start
+    int ret;
     if (stream->total_in == 0)
-        XXH3_64bits_reset(stream->xxh3_state);
+    {
+        if ((ret = zpack_begin_verify(reader, entry, &stream->verify)))
+            return ret;
+
+        if (stream->verify) XXH3_64bits_reset(stream->xxh3_state);
+    }
 
     // set src/apply read back
     zpack_u8* src = stream->next_in;
@@ -536,7 +1530,6 @@ int zpack_read_file_stream(zpack_reader* reader, zpack_file_entry* entry, zpack_
     }
 
     // check if everything is already read
-    int ret;
     if (stream->total_in < entry->comp_size)
     {
         // then read the compressed data
@@ -553,7 +1546,7 @@ int zpack_read_file_stream(zpack_reader* reader, zpack_file_entry* entry, zpack_
     {
         size_t write_size = ZPACK_MIN(stream->avail_out, in_size);
         memcpy(stream->next_out, src, write_size);
-        XXH3_64bits_update(stream->xxh3_state, stream->next_out, write_size);
+        if (stream->verify) XXH3_64bits_update(stream->xxh3_state, stream->next_out, write_size);
 
         ZPACK_ADVANCE_STREAM_OUT(stream, write_size);
         stream->read_back = in_size - write_size;
@@ -569,14 +1562,15 @@ int zpack_read_file_stream(zpack_reader* reader, zpack_file_entry* entry, zpack_
         ZSTD_outBuffer out = { stream->next_out, stream->avail_out, 0 };
         ZSTD_inBuffer  in  = { src, in_size, 0 };
 
-        reader->last_return = ZSTD_decompressStream(dctx, &out, &in);
-        if (ZSTD_isError(reader->last_return))
+        size_t result = ZSTD_decompressStream(dctx, &out, &in);
+        zpack_set_last_return(reader, result);
+        if (ZSTD_isError(result))
         {
             ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
             return ZPACK_ERROR_DECOMPRESS_FAILED;
         }
 
-        XXH3_64bits_update(stream->xxh3_state, stream->next_out, out.pos);
+        if (stream->verify) XXH3_64bits_update(stream->xxh3_state, stream->next_out, out.pos);
         ZPACK_ADVANCE_STREAM_OUT(stream, out.pos);
         stream->read_back = in.size - in.pos;
         break;
@@ -595,10 +1589,10 @@ int zpack_read_file_stream(zpack_reader* reader, zpack_file_entry* entry, zpack_
         dst_size = stream->avail_out;
         src_size = in_size;
 
-        reader->last_return = LZ4F_decompress(dctx, stream->next_out, &dst_size,
-                                              src, &src_size, NULL);
+        size_t result = LZ4F_decompress(dctx, stream->next_out, &dst_size, src, &src_size, NULL);
+        zpack_set_last_return(reader, result);
 
-        if (LZ4F_isError(reader->last_return))
+        if (LZ4F_isError(result))
         {
             LZ4F_resetDecompressionContext(dctx);
             return ZPACK_ERROR_DECOMPRESS_FAILED;
@@ -606,7 +1600,7 @@ int zpack_read_file_stream(zpack_reader* reader, zpack_file_entry* entry, zpack_
 
         if (dst_size)
         {
-            XXH3_64bits_update(stream->xxh3_state, stream->next_out, dst_size);
+            if (stream->verify) XXH3_64bits_update(stream->xxh3_state, stream->next_out, dst_size);
             ZPACK_ADVANCE_STREAM_OUT(stream, dst_size);
         }
 
@@ -628,17 +1622,336 @@ int zpack_read_file_stream(zpack_reader* reader, zpack_file_entry* entry, zpack_
     }
 
     // check if the entire file has been read and decompressed
-    if (ZPACK_READ_STREAM_DONE(stream, entry))
+    if (ZPACK_READ_STREAM_DONE(stream, entry) && stream->verify)
     {
         // verify hash
         zpack_u64 hash = XXH3_64bits_digest(stream->xxh3_state);
         if (entry->hash != hash)
             return ZPACK_ERROR_FILE_HASH_MISMATCH;
+
+        zpack_end_verify(reader, entry);
+    }
+
+    return ZPACK_OK;
+}
+
+// the caller's context if there is one, the stream's own context otherwise
+static int zpack_get_entry_stream_dctx(zpack_entry_stream* stream, zpack_compression_method method, void* dctx)
+{
+    if (dctx)
+    {
+        stream->dctx = dctx;
+        return ZPACK_OK;
+    }
+
+    if (stream->own_dctx && stream->own_dctx_method != method)
+    {
+        zpack_free_dctx(stream->own_dctx_method, stream->own_dctx);
+        stream->own_dctx = NULL;
+    }
+
+    if (!stream->own_dctx)
+    {
+        if ((stream->own_dctx = zpack_create_dctx(method)) == NULL)
+            return ZPACK_ERROR_MALLOC_FAILED;
+        stream->own_dctx_method = method;
+    }
+
+    stream->dctx = stream->own_dctx;
+    return ZPACK_OK;
+}
+
+int zpack_entry_stream_open(zpack_entry_stream* stream, zpack_reader* reader, zpack_file_entry* entry, void* dctx)
+{
+    if (!ZPACK_READER_HAS_IO(reader) && !reader->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+    if (entry->offset + entry->comp_size > reader->file_size)
+        return ZPACK_ERROR_FILE_OFFSET_INVALID;
+
+    stream->reader = reader;
+    stream->entry = entry;
+    stream->dctx = NULL;
+    stream->head = 0;
+    stream->size = 0;
+    stream->total_in = 0;
+    stream->total_out = 0;
+    stream->done = (entry->comp_size == 0);
+
+    // the data is read straight from the archive's buffer if it has one
+    if (ZPACK_READER_HAS_IO(reader) && !stream->buffer)
+    {
+        if (!stream->capacity) stream->capacity = zpack_get_dstream_in_size(ZPACK_COMPRESSION_NONE);
+        stream->buffer = (zpack_u8*)malloc(sizeof(zpack_u8) * stream->capacity);
+        if (stream->buffer == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+    }
+
+    int ret;
+    if ((ret = zpack_begin_verify(reader, entry, &stream->verify)))
+        return ret;
+
+    if (stream->verify)
+    {
+        if (!stream->xxh3_state && (stream->xxh3_state = XXH3_createState()) == NULL)
+            return ZPACK_ERROR_MALLOC_FAILED;
+
+        XXH3_64bits_reset(stream->xxh3_state);
+    }
+
+    // start from a clean decompression state
+    switch (entry->comp_method)
+    {
+    case ZPACK_COMPRESSION_NONE:
+        break;
+
+    case ZPACK_COMPRESSION_ZSTD:
+    #ifndef ZPACK_DISABLE_ZSTD
+        if ((ret = zpack_get_entry_stream_dctx(stream, ZPACK_COMPRESSION_ZSTD, dctx)))
+            return ret;
+
+        ZSTD_DCtx_reset(stream->dctx, ZSTD_reset_session_only);
+        break;
+    #else
+        return ZPACK_ERROR_NOT_AVAILABLE;
+    #endif
+
+    case ZPACK_COMPRESSION_LZ4:
+    #ifndef ZPACK_DISABLE_LZ4
+        if ((ret = zpack_get_entry_stream_dctx(stream, ZPACK_COMPRESSION_LZ4, dctx)))
+            return ret;
+
+        LZ4F_resetDecompressionContext(stream->dctx);
+        break;
+    #else
+        return ZPACK_ERROR_NOT_AVAILABLE;
+    #endif
+
+    default:
+        return ZPACK_ERROR_COMP_METHOD_INVALID;
+    }
+
+    return ZPACK_OK;
+}
+
+// reads compressed data into the free space following the buffered data
+static int zpack_fill_entry_stream(zpack_entry_stream* stream)
+{
+    // start over from the beginning of the buffer if it's empty to read as much as possible
+    if (!stream->size) stream->head = 0;
+
+    size_t tail = (stream->head + stream->size) % stream->capacity;
+    size_t free_size = (tail < stream->head) ? stream->head - tail : stream->capacity - tail;
+    size_t read_size = (size_t)ZPACK_MIN(free_size, stream->entry->comp_size - stream->total_in);
+
+    // the stream's position is its own, the shared file position is only used as a fallback
+    zpack_u64 offset = stream->entry->offset + stream->total_in;
+    int ret = stream->reader->fetch ? zpack_fetch_archive_at(stream->reader, offset, stream->buffer + tail, read_size) :
+                                      zpack_read_file_at(stream->reader->file, offset, stream->buffer + tail, read_size);
+    if (ret == ZPACK_ERROR_NOT_AVAILABLE && stream->reader->file)
+    {
+        if (ZPACK_FSEEK(stream->reader->file, offset, SEEK_SET) != 0)
+            return ZPACK_ERROR_SEEK_FAILED;
+
+        if (ZPACK_FREAD(stream->buffer + tail, 1, read_size, stream->reader->file) != read_size)
+            return ZPACK_ERROR_READ_FAILED;
+    }
+    else if (ret)
+        return ret;
+
+    stream->size += read_size;
+    stream->total_in += read_size;
+    return ZPACK_OK;
+}
+
+static int zpack_decompress_entry_stream(zpack_entry_stream* stream, const zpack_u8* src, size_t src_size,
+                                         zpack_u8* dst, size_t dst_size, size_t* consumed, size_t* written)
+{
+    zpack_reader* reader = stream->reader;
+    switch (stream->entry->comp_method)
+    {
+    case ZPACK_COMPRESSION_NONE:
+        *consumed = *written = ZPACK_MIN(src_size, dst_size);
+        memcpy(dst, src, *written);
+        break;
+
+    #ifndef ZPACK_DISABLE_ZSTD
+    case ZPACK_COMPRESSION_ZSTD:
+    {
+        ZSTD_outBuffer out = { dst, dst_size, 0 };
+        ZSTD_inBuffer  in  = { src, src_size, 0 };
+
+        size_t result = ZSTD_decompressStream(stream->dctx, &out, &in);
+        zpack_set_last_return(reader, result);
+        if (ZSTD_isError(result))
+        {
+            ZSTD_DCtx_reset(stream->dctx, ZSTD_reset_session_only);
+            return ZPACK_ERROR_DECOMPRESS_FAILED;
+        }
+
+        *consumed = in.pos;
+        *written = out.pos;
+        break;
+    }
+    #endif
+
+    #ifndef ZPACK_DISABLE_LZ4
+    case ZPACK_COMPRESSION_LZ4:
+    {
+        *written = dst_size;
+        *consumed = src_size;
+
+        size_t result = LZ4F_decompress(stream->dctx, dst, written, src, consumed, NULL);
+        zpack_set_last_return(reader, result);
+        if (LZ4F_isError(result))
+        {
+            LZ4F_resetDecompressionContext(stream->dctx);
+            return ZPACK_ERROR_DECOMPRESS_FAILED;
+        }
+        break;
+    }
+    #endif
+
+    default:
+        return ZPACK_ERROR_COMP_METHOD_INVALID;
+    }
+
+    return ZPACK_OK;
+}
+
+int zpack_entry_stream_read(zpack_entry_stream* stream, zpack_u8* buffer, size_t size, size_t* read_size)
+{
+    zpack_reader* reader = stream->reader;
+    zpack_file_entry* entry = stream->entry;
+    *read_size = 0;
+
+    int ret;
+    while (*read_size < size && !stream->done)
+    {
+        // the decompressor is given the input up to the end of the ring buffer, the rest follows
+        // in the next iteration so nothing has to be moved around
+        const zpack_u8* src;
+        size_t src_size;
+        if (ZPACK_READER_HAS_IO(reader))
+        {
+            // top up the buffer once half of it has been consumed
+            if (stream->total_in < entry->comp_size && stream->size <= stream->capacity / 2 &&
+                (ret = zpack_fill_entry_stream(stream)))
+                return ret;
+
+            src = stream->buffer + stream->head;
+            src_size = ZPACK_MIN(stream->size, stream->capacity - stream->head);
+        }
+        else
+        {
+            src = reader->buffer + entry->offset + stream->total_in;
+            src_size = (size_t)(entry->comp_size - stream->total_in);
+        }
+
+        size_t consumed, written;
+        if ((ret = zpack_decompress_entry_stream(stream, src, src_size, buffer + *read_size, size - *read_size,
+                                                 &consumed, &written)))
+            return ret;
+
+        if (stream->verify) XXH3_64bits_update(stream->xxh3_state, buffer + *read_size, written);
+        *read_size += written;
+        stream->total_out += written;
+
+        if (ZPACK_READER_HAS_IO(reader))
+        {
+            stream->head = (stream->head + consumed) % stream->capacity;
+            stream->size -= consumed;
+        }
+        else
+            stream->total_in += consumed;
+
+        if (consumed || written) continue;
+
+        // no progress with input left means that the data is invalid
+        if (src_size) return ZPACK_ERROR_DECOMPRESS_FAILED;
+
+        // all of the input has been consumed and the decompressor has nothing left to output
+        stream->done = ZPACK_TRUE;
+        if (stream->verify)
+        {
+            if (entry->hash != XXH3_64bits_digest(stream->xxh3_state))
+                return ZPACK_ERROR_FILE_HASH_MISMATCH;
+
+            zpack_end_verify(reader, entry);
+        }
     }
 
     return ZPACK_OK;
 }
 
+void zpack_entry_stream_close(zpack_entry_stream* stream)
+{
+    free(stream->buffer);
+    XXH3_freeState(stream->xxh3_state);
+    if (stream->own_dctx) zpack_free_dctx(stream->own_dctx_method, stream->own_dctx);
+    memset(stream, 0, sizeof(zpack_entry_stream));
+}
+
+int zpack_read_file_to_sink(zpack_reader* reader, zpack_file_entry* entry, zpack_sink_callback callback,
+                            void* user_data)
+{
+    if (!ZPACK_READER_HAS_IO(reader) && !reader->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+    if (entry->offset + entry->comp_size > reader->file_size)
+        return ZPACK_ERROR_FILE_OFFSET_INVALID;
+
+    int ret;
+    if (!ZPACK_READER_HAS_IO(reader) && entry->comp_method == ZPACK_COMPRESSION_NONE)
+    {
+        // stored files are already in memory, they can be verified before handing them out
+        if (entry->uncomp_size > entry->comp_size)
+            return ZPACK_ERROR_FILE_SIZE_INVALID;
+
+        zpack_bool verify;
+        if ((ret = zpack_begin_verify(reader, entry, &verify)))
+            return ret;
+
+        const zpack_u8* data = reader->buffer + entry->offset;
+        if (verify)
+        {
+            if (XXH3_64bits(data, entry->uncomp_size) != entry->hash)
+                return ZPACK_ERROR_FILE_HASH_MISMATCH;
+
+            zpack_end_verify(reader, entry);
+        }
+
+        return entry->uncomp_size ? callback(data, (size_t)entry->uncomp_size, user_data) : ZPACK_OK;
+    }
+
+    size_t window_size = zpack_get_dstream_out_size(entry->comp_method);
+    if (!window_size) return ZPACK_ERROR_COMP_METHOD_INVALID;
+
+    zpack_u8* window = (zpack_u8*)malloc(window_size);
+    if (window == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    // without a pool, the stream creates its own context
+    void* pooled_dctx = NULL;
+    if (entry->comp_method != ZPACK_COMPRESSION_NONE && ZPACK_USE_DCTX_POOL(reader, entry->comp_method))
+    {
+        if ((pooled_dctx = zpack_checkout_dctx(reader, entry->comp_method)) == NULL)
+        {
+            free(window);
+            return ZPACK_ERROR_MALLOC_FAILED;
+        }
+    }
+
+    zpack_entry_stream stream;
+    memset(&stream, 0, sizeof(zpack_entry_stream));
+    ret = zpack_entry_stream_open(&stream, reader, entry, pooled_dctx);
+    while (!ret && !stream.done)
+    {
+        size_t read_size;
+        if ((ret = zpack_entry_stream_read(&stream, window, window_size, &read_size)) == ZPACK_OK && read_size)
+            ret = callback(window, read_size, user_data);
+    }
+
+    zpack_entry_stream_close(&stream);
+    if (pooled_dctx) zpack_return_dctx(reader, entry->comp_method, pooled_dctx);
+    free(window);
+    return ret;
+}
+
 int zpack_init_reader(zpack_reader* reader, const char* path)
 {
     FILE* fp = ZPACK_FOPEN(path, "rb");
@@ -676,6 +1989,137 @@ int zpack_init_reader_memory_shared(zpack_reader* reader, zpack_u8* buffer, size
     return zpack_read_archive_memory(reader);
 }
 
+int zpack_init_reader_mmap(zpack_reader* reader, const char* path)
+{
+    int ret;
+    zpack_u8* buffer;
+    size_t size;
+    if ((ret = zpack_map_file(path, &buffer, &size)))
+        return ret;
+
+    reader->buffer = buffer;
+    reader->file_size = size;
+    reader->buffer_shared = ZPACK_FALSE;
+    reader->buffer_mapped = ZPACK_TRUE;
+
+    return zpack_read_archive_memory(reader);
+}
+
+// data that clones of a reader share (see zpack_clone_reader)
+typedef struct zpack_reader_shared_s
+{
+    volatile size_t ref_count;
+    zpack_reader owner; // copy of the first reader, holds the shared data
+
+} zpack_reader_shared;
+
+// frees the parsed CDR and the archive's buffer, which are shared between clones
+static void zpack_free_reader_data(zpack_reader* reader)
+{
+    if (reader->buffer_mapped)
+        zpack_unmap_file(reader->buffer, reader->file_size);
+    else if (!reader->buffer_shared)
+        free(reader->buffer);
+
+    // filenames share the allocation with the entries
+    free(reader->file_entries);
+    zpack_free_file_index(&reader->file_index);
+    zpack_free_dir_index(&reader->dir_index);
+    zpack_free_entry_table(&reader->entry_table);
+    zpack_unmap_file(reader->sidecar, reader->sidecar_size);
+}
+
+int zpack_clone_reader(zpack_reader* reader, zpack_reader* source, const char* path)
+{
+#ifdef ZPACK_HAVE_ATOMICS
+    if (!ZPACK_READER_HAS_IO(source) && !source->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+
+    // file readers get a handle of their own
+    FILE* fp = NULL;
+    if (source->file)
+    {
+        if (!path || !(fp = ZPACK_FOPEN(path, "rb"))) return ZPACK_ERROR_OPEN_FAILED;
+        if (ZPACK_FSEEK(fp, 0, SEEK_END) != 0)
+        {
+            ZPACK_FCLOSE(fp);
+            return ZPACK_ERROR_SEEK_FAILED;
+        }
+        if ((zpack_u64)ZPACK_FTELL(fp) != source->file_size)
+        {
+            ZPACK_FCLOSE(fp);
+            return ZPACK_ERROR_FILE_SIZE_INVALID;
+        }
+    }
+
+    // the data is handed over to the shared state the first time the reader is cloned
+    zpack_reader_shared* shared = (zpack_reader_shared*)source->shared;
+    if (!shared)
+    {
+        shared = (zpack_reader_shared*)malloc(sizeof(zpack_reader_shared));
+        if (shared == NULL)
+        {
+            if (fp) ZPACK_FCLOSE(fp);
+            return ZPACK_ERROR_MALLOC_FAILED;
+        }
+        shared->ref_count = 1;
+        shared->owner = *source;
+        source->shared = shared;
+    }
+    zpack_atomic_fetch_add_size(&shared->ref_count, 1);
+
+    memset(reader, 0, sizeof(zpack_reader));
+    reader->flags = source->flags;
+    reader->version = source->version;
+    reader->file_entries = source->file_entries;
+    reader->file_count = source->file_count;
+    reader->file_index = source->file_index;
+    reader->dir_index = source->dir_index;
+    reader->entry_table = source->entry_table;
+    reader->comp_size = source->comp_size;
+    reader->uncomp_size = source->uncomp_size;
+    reader->file_size = source->file_size;
+    reader->dctx_pool_size = source->dctx_pool_size;
+    reader->parse_thread_count = source->parse_thread_count;
+    reader->cdr_offset = source->cdr_offset;
+    reader->eocdr_offset = source->eocdr_offset;
+    reader->buffer = source->buffer;
+    reader->buffer_shared = ZPACK_TRUE;
+    reader->buffer_mapped = source->buffer_mapped;
+    reader->file = fp;
+    reader->verify_policy = source->verify_policy;
+    reader->cache_budget = source->cache_budget;
+    reader->tail_read_size = source->tail_read_size;
+    reader->sidecar_path = source->sidecar_path;
+    reader->sidecar = source->sidecar;
+    reader->sidecar_size = source->sidecar_size;
+    reader->fetch = source->fetch;
+    reader->fetch_user_data = source->fetch_user_data;
+    reader->fetch_block_size = source->fetch_block_size;
+    reader->fetch_cache_size = source->fetch_cache_size;
+    reader->shared = shared;
+
+    // everything else is per reader
+    int ret;
+    if ((ret = zpack_init_dctx_pools(reader)) || (ret = zpack_init_cache(reader)))
+        return ret;
+
+    if (reader->fetch && (ret = zpack_init_fetch_cache(reader)))
+        return ret;
+
+#ifdef ZPACK_HAVE_IO_URING
+    if (fp && (reader->flags & ZPACK_READER_ASYNC_IO))
+        zpack_uring_init((void**)&reader->async_io, ZPACK_ASYNC_IO_QUEUE_DEPTH);
+#endif
+
+    if (reader->flags & ZPACK_READER_SKIP_FILE_ENTRIES)
+        return ZPACK_OK;
+
+    return zpack_init_verifier(reader);
+#else
+    return ZPACK_ERROR_NOT_AVAILABLE;
+#endif
+}
+
 void zpack_reset_reader_dctx(zpack_reader* reader)
 {
 #ifndef ZPACK_DISABLE_ZSTD
@@ -691,26 +2135,42 @@ void zpack_reset_reader_dctx(zpack_reader* reader)
 
 void zpack_close_reader(zpack_reader* reader)
 {
+    // stop the background threads before anything they use is freed
+    zpack_free_verifier(reader);
+    zpack_free_prefetcher(reader);
+
     if (reader->file)
         ZPACK_FCLOSE(reader->file);
 
-    if (!reader->buffer_shared)
-        free(reader->buffer);
-
-    if (reader->file_entries)
+    // the last reader sharing the data frees it
+    zpack_reader_shared* shared = (zpack_reader_shared*)reader->shared;
+    if (!shared)
+        zpack_free_reader_data(reader);
+#ifdef ZPACK_HAVE_ATOMICS
+    else if (zpack_atomic_fetch_add_size(&shared->ref_count, (size_t)-1) == 1)
     {
-        for (zpack_u64 i = 0; i < reader->file_count; ++i)
-            free(reader->file_entries[i].filename);
-
-        free(reader->file_entries);
+        zpack_free_reader_data(&shared->owner);
+        free(shared);
     }
+#endif
+
+    zpack_free_scratch(&reader->scratch);
+    zpack_free_cache(reader);
+    zpack_free_fetch_cache(reader);
+    zpack_free_cdr_buffer(reader);
+
+#ifdef ZPACK_HAVE_IO_URING
+    zpack_uring_free(reader->async_io);
+#endif
 
 #ifndef ZPACK_DISABLE_ZSTD
     ZSTD_freeDCtx(reader->zstd_dctx);
+    zpack_free_dctx_pool(reader->zstd_dctx_pool, reader->dctx_pool_size, ZPACK_COMPRESSION_ZSTD);
 #endif
 
 #ifndef ZPACK_DISABLE_LZ4
     LZ4F_freeDecompressionContext(reader->lz4f_dctx);
+    zpack_free_dctx_pool(reader->lz4f_dctx_pool, reader->dctx_pool_size, ZPACK_COMPRESSION_LZ4);
 #endif
 
     memset(reader, 0, sizeof(zpack_reader));
@@ -759,7 +2219,7 @@ size_t zpack_get_dstream_out_size(zpack_compression_method method)
 
 zpack_file_entry* zpack_get_file_entry(const char* filename, zpack_file_entry* file_entries, zpack_u64 file_count)
 {
-    for (int i = 0; i < file_count; ++i)
+    for (zpack_u64 i = 0; i < file_count; ++i)
     {
         if (strcmp(file_entries[i].filename, filename) == 0)
             return file_entries + i;
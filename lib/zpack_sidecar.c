@@ -0,0 +1,228 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Sidecar index layout:
+ *
+ *  0  u32 signature        (ZPACK_SIDECAR_SIGNATURE)
+ *  4  u16 sidecar version  (ZPACK_SIDECAR_VERSION)
+ *  6  u16 archive version
+ *  8  u32 byte order mark  (written in the machine's byte order)
+ *  12 u32 reserved
+ *  16 u64 archive size
+ *  24 u64 cdr offset
+ *  32 u64 cdr hash         (XXH3 of the CDR header and block)
+ *  40 u64 entry count
+ *  48 u64 names size
+ *  56 u64 index capacity
+ *  64 u64 index count
+ *  72 entry table          (same layout as in memory, see zpack_layout_entry_table)
+ *     padding to 8 bytes
+ *     index slots
+ *
+ * The header is little endian, the entry table and the index are stored in the machine's byte order.
+ */
+#define ZPACK_SIDECAR_BYTE_ORDER_MARK 0x01020304
+
+static zpack_u64 zpack_get_sidecar_slots_offset(zpack_u64 count, zpack_u64 names_size)
+{
+    zpack_u64 table_size = count * ZPACK_ENTRY_TABLE_ROW_SIZE + names_size;
+    return ZPACK_SIDECAR_HEADER_SIZE + ((table_size + 7) & ~(zpack_u64)7);
+}
+
+static int zpack_write_sidecar_data(FILE* fp, const zpack_u8* header, const zpack_entry_table* table)
+{
+    static const zpack_u8 padding[8] = { 0 };
+    size_t table_size = (size_t)(table->count * ZPACK_ENTRY_TABLE_ROW_SIZE + table->names_size);
+    size_t padding_size = (size_t)(zpack_get_sidecar_slots_offset(table->count, table->names_size) -
+                                   ZPACK_SIDECAR_HEADER_SIZE - table_size);
+    size_t slots_size = (size_t)table->index.capacity * sizeof(zpack_file_index_slot);
+
+    // the arrays and the string pool are contiguous
+    if (ZPACK_FWRITE(header, 1, ZPACK_SIDECAR_HEADER_SIZE, fp) != ZPACK_SIDECAR_HEADER_SIZE ||
+        ZPACK_FWRITE(table->offsets, 1, table_size, fp) != table_size ||
+        ZPACK_FWRITE(padding, 1, padding_size, fp) != padding_size ||
+        ZPACK_FWRITE(table->index.slots, 1, slots_size, fp) != slots_size)
+        return ZPACK_ERROR_WRITE_FAILED;
+
+    return ZPACK_OK;
+}
+
+int zpack_write_sidecar_index(zpack_reader* reader, const char* path)
+{
+    if (!ZPACK_READER_HAS_IO(reader) && !reader->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+
+    int ret;
+    zpack_u64 cdr_hash;
+    if ((ret = zpack_hash_cdr(reader, &cdr_hash)))
+        return ret;
+
+    // use the reader's table if it has one
+    zpack_entry_table temp_table;
+    memset(&temp_table, 0, sizeof(zpack_entry_table));
+    zpack_entry_table* table = &reader->entry_table;
+    if (!table->offsets)
+    {
+        if ((ret = zpack_init_entry_table(&temp_table, reader)))
+            return ret;
+        table = &temp_table;
+    }
+
+    zpack_u8 header[ZPACK_SIDECAR_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    zpack_u32 byte_order_mark = ZPACK_SIDECAR_BYTE_ORDER_MARK;
+
+    zpack_write_le32(header, ZPACK_SIDECAR_SIGNATURE);
+    zpack_write_le16(header + 4, ZPACK_SIDECAR_VERSION);
+    zpack_write_le16(header + 6, reader->version);
+    memcpy(header + 8, &byte_order_mark, sizeof(zpack_u32));
+    zpack_write_le64(header + 16, reader->file_size);
+    zpack_write_le64(header + 24, reader->cdr_offset);
+    zpack_write_le64(header + 32, cdr_hash);
+    zpack_write_le64(header + 40, table->count);
+    zpack_write_le64(header + 48, table->names_size);
+    zpack_write_le64(header + 56, table->index.capacity);
+    zpack_write_le64(header + 64, table->index.count);
+
+    // readers may have the current sidecar mapped, so it's replaced instead of being truncated and rewritten
+    size_t temp_path_size = strlen(path) + ZPACK_TEMP_FILE_SUFFIX_SIZE;
+    char* temp_path = (char*)malloc(temp_path_size);
+    if (temp_path == NULL)
+    {
+        zpack_free_entry_table(&temp_table);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+
+    FILE* fp = zpack_create_temp_file(path, temp_path, temp_path_size);
+    if (fp == NULL)
+    {
+        free(temp_path);
+        zpack_free_entry_table(&temp_table);
+        return ZPACK_ERROR_OPEN_FAILED;
+    }
+
+    ret = zpack_write_sidecar_data(fp, header, table);
+    if (ZPACK_FCLOSE(fp) != 0 && ret == ZPACK_OK)
+        ret = ZPACK_ERROR_WRITE_FAILED;
+
+    if (ret == ZPACK_OK)
+        ret = zpack_replace_file(temp_path, path);
+
+    if (ret) zpack_remove_file(temp_path);
+    free(temp_path);
+    zpack_free_entry_table(&temp_table);
+    return ret;
+}
+
+// checks that the sidecar belongs to the archive and that its contents can be used safely
+static int zpack_read_sidecar_index(zpack_reader* reader, zpack_u8* buffer, size_t size, zpack_entry_table* table)
+{
+    if (size < ZPACK_SIDECAR_HEADER_SIZE || !ZPACK_VERIFY_SIGNATURE(buffer, ZPACK_SIDECAR_SIGNATURE))
+        return ZPACK_ERROR_SIGNATURE_INVALID;
+
+    zpack_u32 byte_order_mark;
+    memcpy(&byte_order_mark, buffer + 8, sizeof(zpack_u32));
+    if (ZPACK_READ_LE16(buffer + 4) != ZPACK_SIDECAR_VERSION || byte_order_mark != ZPACK_SIDECAR_BYTE_ORDER_MARK)
+        return ZPACK_ERROR_VERSION_INCOMPATIBLE;
+
+    // the sidecar must have been written for this version of the archive
+    if (ZPACK_READ_LE16(buffer + 6) != reader->version ||
+        ZPACK_READ_LE64(buffer + 16) != reader->file_size ||
+        ZPACK_READ_LE64(buffer + 24) != reader->cdr_offset)
+        return ZPACK_ERROR_FILE_HASH_MISMATCH;
+
+    zpack_u64 count = ZPACK_READ_LE64(buffer + 40);
+    zpack_u64 names_size = ZPACK_READ_LE64(buffer + 48);
+    zpack_u64 capacity = ZPACK_READ_LE64(buffer + 56);
+    zpack_u64 index_count = ZPACK_READ_LE64(buffer + 64);
+
+    // every filename has a null terminator, and the index needs at least one empty slot
+    if (names_size > UINT32_MAX || count > names_size ||
+        capacity == 0 || (capacity & (capacity - 1)) || index_count >= capacity ||
+        capacity > size / sizeof(zpack_file_index_slot))
+        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+    zpack_u64 slots_offset = zpack_get_sidecar_slots_offset(count, names_size);
+    if (slots_offset + capacity * sizeof(zpack_file_index_slot) != size)
+        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+    int ret;
+    zpack_u64 cdr_hash;
+    if ((ret = zpack_hash_cdr(reader, &cdr_hash)))
+        return ret;
+
+    if (ZPACK_READ_LE64(buffer + 32) != cdr_hash)
+        return ZPACK_ERROR_FILE_HASH_MISMATCH;
+
+    memset(table, 0, sizeof(zpack_entry_table));
+    zpack_layout_entry_table(table, buffer + ZPACK_SIDECAR_HEADER_SIZE, count);
+    table->count = count;
+    table->names_size = (size_t)names_size;
+    table->index.slots = (zpack_file_index_slot*)(buffer + slots_offset);
+    table->index.capacity = capacity;
+    table->index.count = index_count;
+    table->shared = ZPACK_TRUE;
+
+    // make sure that lookups can't go out of bounds
+    if (count && table->names[names_size - 1] != '\0')
+        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+    for (zpack_u64 i = 0; i < count; ++i)
+    {
+        if (table->name_offsets[i] >= names_size)
+            return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+    }
+
+    zpack_u64 used_slots = 0;
+    for (zpack_u64 i = 0; i < capacity; ++i)
+    {
+        zpack_u64 entry = table->index.slots[i].entry;
+        if (entry > count)
+            return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+        if (entry) ++used_slots;
+    }
+    if (used_slots != index_count)
+        return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+
+    return ZPACK_OK;
+}
+
+int zpack_map_sidecar_index(zpack_reader* reader, const char* path)
+{
+    if (!ZPACK_READER_HAS_IO(reader) && !reader->buffer) return ZPACK_ERROR_ARCHIVE_NOT_LOADED;
+
+    // the entry table of readers that share their data with clones can't be replaced
+    if (reader->shared) return ZPACK_ERROR_NOT_AVAILABLE;
+
+    int ret;
+    zpack_u8* buffer;
+    size_t size;
+    if ((ret = zpack_map_file(path, &buffer, &size)))
+        return ret;
+
+    zpack_entry_table table;
+    if ((ret = zpack_read_sidecar_index(reader, buffer, size, &table)))
+    {
+        zpack_unmap_file(buffer, size);
+        return ret;
+    }
+
+    zpack_free_entry_table(&reader->entry_table);
+    zpack_unmap_file(reader->sidecar, reader->sidecar_size);
+
+    reader->entry_table = table;
+    reader->sidecar = buffer;
+    reader->sidecar_size = size;
+    return ZPACK_OK;
+}
+
+int zpack_load_entry_table(zpack_reader* reader)
+{
+    // a missing or stale sidecar isn't an error, the table is built from the CDR instead
+    if (reader->sidecar_path && zpack_map_sidecar_index(reader, reader->sidecar_path) == ZPACK_OK)
+        return ZPACK_OK;
+
+    return zpack_init_entry_table(&reader->entry_table, reader);
+}
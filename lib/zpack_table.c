@@ -0,0 +1,116 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+void zpack_layout_entry_table(zpack_entry_table* table, zpack_u8* buffer, zpack_u64 count)
+{
+    table->offsets      = (zpack_u64*)buffer;
+    table->comp_sizes   = table->offsets + count;
+    table->uncomp_sizes = table->comp_sizes + count;
+    table->hashes       = table->uncomp_sizes + count;
+    table->name_offsets = (zpack_u32*)(table->hashes + count);
+    table->comp_methods = (zpack_u8*)(table->name_offsets + count);
+    table->names        = (char*)(table->comp_methods + count);
+}
+
+int zpack_init_entry_table(zpack_entry_table* table, zpack_reader* reader)
+{
+    zpack_free_entry_table(table);
+
+    int ret;
+    zpack_cdr_iterator iterator;
+    if ((ret = zpack_init_cdr_iterator(&iterator, reader, 0)))
+    {
+        zpack_close_cdr_iterator(&iterator);
+        return ret;
+    }
+
+    // every byte of the block that isn't a fixed field + a null terminator for each filename
+    zpack_u64 count = iterator.count;
+    zpack_u64 names_size = iterator.size_left - count * ZPACK_FILE_ENTRY_FIXED_SIZE + count;
+    if (names_size > UINT32_MAX)
+    {
+        zpack_close_cdr_iterator(&iterator);
+        return ZPACK_ERROR_FILENAME_TOO_LONG;
+    }
+
+    // the arrays share a single allocation, ordered by alignment
+    if (count > (SIZE_MAX - names_size) / ZPACK_ENTRY_TABLE_ROW_SIZE)
+    {
+        zpack_close_cdr_iterator(&iterator);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+    zpack_u8* buffer = (zpack_u8*)malloc((size_t)(count * ZPACK_ENTRY_TABLE_ROW_SIZE + names_size) + 1);
+    if (buffer == NULL)
+    {
+        zpack_close_cdr_iterator(&iterator);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+
+    zpack_layout_entry_table(table, buffer, count);
+
+    zpack_u32 names_pos = 0;
+    while (!ZPACK_CDR_ITERATOR_DONE(&iterator))
+    {
+        zpack_u64 i = iterator.index;
+        zpack_file_entry entry;
+        if ((ret = zpack_next_cdr_entry(&iterator, &entry)))
+        {
+            zpack_close_cdr_iterator(&iterator);
+            zpack_free_entry_table(table);
+            return ret;
+        }
+
+        size_t length = strlen(entry.filename) + 1;
+        if (length > names_size - names_pos)
+        {
+            zpack_close_cdr_iterator(&iterator);
+            zpack_free_entry_table(table);
+            return ZPACK_ERROR_BLOCK_SIZE_INVALID;
+        }
+        memcpy(table->names + names_pos, entry.filename, length);
+
+        table->offsets[i]      = entry.offset;
+        table->comp_sizes[i]   = entry.comp_size;
+        table->uncomp_sizes[i] = entry.uncomp_size;
+        table->hashes[i]       = entry.hash;
+        table->name_offsets[i] = names_pos;
+        table->comp_methods[i] = entry.comp_method;
+
+        names_pos += (zpack_u32)length;
+        ++table->count;
+    }
+    table->names_size = names_pos;
+    zpack_close_cdr_iterator(&iterator);
+
+    // filename lookup index
+    if ((ret = zpack_init_entry_table_index(table)))
+    {
+        zpack_free_entry_table(table);
+        return ret;
+    }
+
+    return ZPACK_OK;
+}
+
+void zpack_get_entry_view(const zpack_entry_table* table, zpack_u64 index, zpack_file_entry* entry)
+{
+    entry->filename    = ZPACK_ENTRY_TABLE_NAME(table, index);
+    entry->offset      = table->offsets[index];
+    entry->comp_size   = table->comp_sizes[index];
+    entry->uncomp_size = table->uncomp_sizes[index];
+    entry->hash        = table->hashes[index];
+    entry->comp_method = table->comp_methods[index];
+}
+
+void zpack_free_entry_table(zpack_entry_table* table)
+{
+    // the other arrays share the allocation with the offsets, mapped tables are owned by the reader
+    if (!table->shared)
+    {
+        free(table->offsets);
+        zpack_free_file_index(&table->index);
+    }
+    memset(table, 0, sizeof(zpack_entry_table));
+}
@@ -0,0 +1,216 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ZPACK_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+
+// liburing is not used, the ring is set up with the raw system calls
+typedef struct zpack_uring_s
+{
+    int fd;
+    unsigned entries;
+    unsigned pending; // queued but not yet submitted
+
+    // submission queue
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+
+    // completion queue
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+
+} zpack_uring;
+
+static void zpack_unmap_uring(zpack_uring* ring)
+{
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED) munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+}
+
+int zpack_uring_init(void** handle, unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // fails with ENOSYS/EPERM if the kernel doesn't support io_uring or it has been disabled
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) return ZPACK_ERROR_NOT_AVAILABLE;
+
+    zpack_uring* ring = (zpack_uring*)calloc(1, sizeof(zpack_uring));
+    if (ring == NULL)
+    {
+        close(fd);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sq_size = ring->cq_size = ZPACK_MAX(ring->sq_size, ring->cq_size);
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED)
+    {
+        zpack_unmap_uring(ring);
+        free(ring);
+        return ZPACK_ERROR_NOT_AVAILABLE;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->cq_ptr = ring->sq_ptr;
+    else
+    {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED)
+        {
+            zpack_unmap_uring(ring);
+            free(ring);
+            return ZPACK_ERROR_NOT_AVAILABLE;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                            fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        zpack_unmap_uring(ring);
+        free(ring);
+        return ZPACK_ERROR_NOT_AVAILABLE;
+    }
+
+    zpack_u8* sq = (zpack_u8*)ring->sq_ptr;
+    ring->sq_head  = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail  = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask  = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+
+    zpack_u8* cq = (zpack_u8*)ring->cq_ptr;
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes    = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    *handle = ring;
+    return ZPACK_OK;
+}
+
+unsigned zpack_uring_entries(void* handle)
+{
+    return ((zpack_uring*)handle)->entries;
+}
+
+// returns a cleared entry at the submission queue's tail, or NULL if the queue is full
+static struct io_uring_sqe* zpack_uring_get_sqe(zpack_uring* ring)
+{
+    unsigned tail = *ring->sq_tail;
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->entries)
+        return NULL;
+
+    struct io_uring_sqe* sqe = ring->sqes + (tail & *ring->sq_mask);
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+// makes the entry returned by zpack_uring_get_sqe visible to the kernel
+static void zpack_uring_push_sqe(zpack_uring* ring)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++ring->pending;
+}
+
+int zpack_uring_queue_read(void* handle, FILE* fp, zpack_u8* buffer, size_t size, zpack_u64 offset, zpack_u64 user_data)
+{
+    zpack_uring* ring = (zpack_uring*)handle;
+    struct io_uring_sqe* sqe = zpack_uring_get_sqe(ring);
+    if (sqe == NULL) return ZPACK_ERROR_BUFFER_TOO_SMALL;
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fileno(fp);
+    sqe->addr = (zpack_u64)(uintptr_t)buffer;
+    sqe->len = (unsigned)ZPACK_MIN(size, 1U << 30); // the rest is read after the short read completes
+    sqe->off = offset;
+    sqe->user_data = user_data;
+
+    zpack_uring_push_sqe(ring);
+    return ZPACK_OK;
+}
+
+int zpack_uring_queue_cancel(void* handle, zpack_u64 target, zpack_u64 user_data)
+{
+    zpack_uring* ring = (zpack_uring*)handle;
+    struct io_uring_sqe* sqe = zpack_uring_get_sqe(ring);
+    if (sqe == NULL) return ZPACK_ERROR_BUFFER_TOO_SMALL;
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+
+    zpack_uring_push_sqe(ring);
+    return ZPACK_OK;
+}
+
+int zpack_uring_wait(void* handle, zpack_u64* user_data, int* result)
+{
+    zpack_uring* ring = (zpack_uring*)handle;
+    for (;;)
+    {
+        // submit everything that has been queued, and wait for a completion if there's none available
+        unsigned head = *ring->cq_head;
+        zpack_bool empty = head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        if (ring->pending || empty)
+        {
+            int ret = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, empty ? 1 : 0,
+                                   empty ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+            if (ret < 0)
+            {
+                if (errno == EINTR) continue;
+                return ZPACK_ERROR_READ_FAILED;
+            }
+            ring->pending -= (unsigned)ret;
+            if (empty) continue;
+        }
+
+        struct io_uring_cqe* cqe = ring->cqes + (head & *ring->cq_mask);
+        *user_data = cqe->user_data;
+        *result = cqe->res;
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+        return ZPACK_OK;
+    }
+}
+
+void zpack_uring_free(void* handle)
+{
+    zpack_uring* ring = (zpack_uring*)handle;
+    if (!ring) return;
+
+    zpack_unmap_uring(ring);
+    free(ring);
+}
+
+#endif // ZPACK_HAVE_IO_URING
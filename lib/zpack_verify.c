@@ -0,0 +1,260 @@
+#include "zpack.h"
+#include "zpack_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ZPACK_VERIFY_QUEUE_SIZE 1024
+
+#define ZPACK_BITMAP_WORD(i) ((size_t)((i) >> 5))
+#define ZPACK_BITMAP_BIT(i) ((zpack_u32)1 << ((i) & 31))
+
+#if defined(ZPACK_HAVE_ATOMICS) && defined(ZPACK_HAVE_THREADS)
+#define ZPACK_HAVE_BACKGROUND_VERIFY
+
+typedef struct zpack_verifier_s
+{
+    zpack_reader* reader;
+    zpack_thread thread;
+    zpack_mutex mutex;
+    zpack_cond cond;      // signaled when an entry is queued or the verifier is stopped
+    zpack_cond idle_cond; // signaled when the queue has been emptied
+
+    // entries waiting to be verified
+    zpack_u64 queue[ZPACK_VERIFY_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    zpack_u32* queued_entries; // bitmap to avoid queueing the same entry twice
+
+    zpack_bool busy;
+    zpack_bool stop;
+
+} zpack_verifier;
+
+static void zpack_verifier_main(void* arg)
+{
+    zpack_verifier* verifier = (zpack_verifier*)arg;
+    zpack_reader* reader = verifier->reader;
+
+    zpack_u8* buffer = NULL;
+    size_t capacity = 0;
+    zpack_scratch scratch = { NULL, 0 };
+
+    zpack_mutex_lock(&verifier->mutex);
+    for (;;)
+    {
+        while (!verifier->count && !verifier->stop)
+            zpack_cond_wait(&verifier->cond, &verifier->mutex);
+
+        if (verifier->stop) break;
+
+        zpack_u64 index = verifier->queue[verifier->head];
+        verifier->head = (verifier->head + 1) % ZPACK_VERIFY_QUEUE_SIZE;
+        --verifier->count;
+        verifier->busy = ZPACK_TRUE;
+        zpack_mutex_unlock(&verifier->mutex);
+
+        int ret = zpack_verify_file(reader, reader->file_entries + index, &buffer, &capacity, &scratch);
+        if (ret == ZPACK_OK)
+            zpack_atomic_or_u32(reader->verified_entries + ZPACK_BITMAP_WORD(index), ZPACK_BITMAP_BIT(index));
+        else if (ret == ZPACK_ERROR_FILE_HASH_MISMATCH)
+            zpack_atomic_or_u32(reader->corrupted_entries + ZPACK_BITMAP_WORD(index), ZPACK_BITMAP_BIT(index));
+
+        // other errors leave the entry unverified, it will be queued again on the next read
+        zpack_mutex_lock(&verifier->mutex);
+        verifier->queued_entries[ZPACK_BITMAP_WORD(index)] &= ~ZPACK_BITMAP_BIT(index);
+        verifier->busy = ZPACK_FALSE;
+        if (!verifier->count) zpack_cond_broadcast(&verifier->idle_cond);
+    }
+    zpack_mutex_unlock(&verifier->mutex);
+
+    free(buffer);
+    zpack_free_scratch(&scratch);
+}
+
+static void zpack_queue_verify(zpack_verifier* verifier, zpack_u64 index)
+{
+    zpack_mutex_lock(&verifier->mutex);
+
+    // the entry stays unverified if the queue is full
+    if (!(verifier->queued_entries[ZPACK_BITMAP_WORD(index)] & ZPACK_BITMAP_BIT(index)) &&
+        verifier->count < ZPACK_VERIFY_QUEUE_SIZE)
+    {
+        verifier->queue[(verifier->head + verifier->count) % ZPACK_VERIFY_QUEUE_SIZE] = index;
+        ++verifier->count;
+        verifier->queued_entries[ZPACK_BITMAP_WORD(index)] |= ZPACK_BITMAP_BIT(index);
+        zpack_cond_signal(&verifier->cond);
+    }
+
+    zpack_mutex_unlock(&verifier->mutex);
+}
+
+static int zpack_start_verifier(zpack_reader* reader, size_t bitmap_size)
+{
+    zpack_verifier* verifier = (zpack_verifier*)calloc(1, sizeof(zpack_verifier));
+    if (verifier == NULL) return ZPACK_ERROR_MALLOC_FAILED;
+
+    verifier->reader = reader;
+    verifier->queued_entries = (zpack_u32*)calloc(bitmap_size, sizeof(zpack_u32));
+    if (verifier->queued_entries == NULL)
+    {
+        free(verifier);
+        return ZPACK_ERROR_MALLOC_FAILED;
+    }
+
+    int ret;
+    if ((ret = zpack_mutex_init(&verifier->mutex)))
+    {
+        free(verifier->queued_entries);
+        free(verifier);
+        return ret;
+    }
+
+    if ((ret = zpack_cond_init(&verifier->cond)))
+    {
+        zpack_mutex_destroy(&verifier->mutex);
+        free(verifier->queued_entries);
+        free(verifier);
+        return ret;
+    }
+
+    if ((ret = zpack_cond_init(&verifier->idle_cond)))
+    {
+        zpack_cond_destroy(&verifier->cond);
+        zpack_mutex_destroy(&verifier->mutex);
+        free(verifier->queued_entries);
+        free(verifier);
+        return ret;
+    }
+
+    if ((ret = zpack_thread_create(&verifier->thread, zpack_verifier_main, verifier)))
+    {
+        zpack_cond_destroy(&verifier->idle_cond);
+        zpack_cond_destroy(&verifier->cond);
+        zpack_mutex_destroy(&verifier->mutex);
+        free(verifier->queued_entries);
+        free(verifier);
+        return ret;
+    }
+
+    reader->verifier = verifier;
+    return ZPACK_OK;
+}
+#endif // ZPACK_HAVE_BACKGROUND_VERIFY
+
+int zpack_init_verifier(zpack_reader* reader)
+{
+    zpack_free_verifier(reader);
+
+    if (reader->verify_policy != ZPACK_VERIFY_ONCE && reader->verify_policy != ZPACK_VERIFY_BACKGROUND)
+        return ZPACK_OK;
+
+    // without the entries there's nothing to keep track of, every read will be verified
+    if (!reader->file_entries || !reader->file_count)
+        return ZPACK_OK;
+
+#ifdef ZPACK_HAVE_ATOMICS
+    zpack_u64 bitmap_size = ZPACK_BITMAP_WORD(reader->file_count + 31);
+    if (bitmap_size > SIZE_MAX / sizeof(zpack_u32)) return ZPACK_ERROR_MALLOC_FAILED;
+
+    reader->verified_entries  = (volatile zpack_u32*)calloc((size_t)bitmap_size, sizeof(zpack_u32));
+    reader->corrupted_entries = (volatile zpack_u32*)calloc((size_t)bitmap_size, sizeof(zpack_u32));
+    if (!reader->verified_entries || !reader->corrupted_entries)
+        return ZPACK_ERROR_MALLOC_FAILED;
+
+#ifdef ZPACK_HAVE_BACKGROUND_VERIFY
+    // the verifier thread can only read the archive concurrently with the buffer or positional I/O
+    if (reader->verify_policy == ZPACK_VERIFY_BACKGROUND &&
+        (reader->buffer || (reader->flags & ZPACK_READER_POSITIONAL_IO)))
+        return zpack_start_verifier(reader, (size_t)bitmap_size);
+#endif
+#endif
+
+    return ZPACK_OK;
+}
+
+int zpack_begin_verify(zpack_reader* reader, zpack_file_entry* entry, zpack_bool* verify)
+{
+    *verify = reader->verify_policy != ZPACK_VERIFY_NEVER;
+    if (reader->verify_policy != ZPACK_VERIFY_ONCE && reader->verify_policy != ZPACK_VERIFY_BACKGROUND)
+        return ZPACK_OK;
+
+    // entries that don't belong to the reader's entry array are always verified
+    if (!reader->verified_entries || entry < reader->file_entries || entry >= reader->file_entries + reader->file_count)
+        return ZPACK_OK;
+
+#ifdef ZPACK_HAVE_ATOMICS
+    zpack_u64 index = entry - reader->file_entries;
+    size_t word = ZPACK_BITMAP_WORD(index);
+    zpack_u32 bit = ZPACK_BITMAP_BIT(index);
+
+    if (zpack_atomic_load_u32(reader->corrupted_entries + word) & bit)
+        return ZPACK_ERROR_FILE_HASH_MISMATCH;
+
+    if (zpack_atomic_load_u32(reader->verified_entries + word) & bit)
+    {
+        *verify = ZPACK_FALSE;
+        return ZPACK_OK;
+    }
+
+#ifdef ZPACK_HAVE_BACKGROUND_VERIFY
+    if (reader->verify_policy == ZPACK_VERIFY_BACKGROUND && reader->verifier)
+    {
+        zpack_queue_verify((zpack_verifier*)reader->verifier, index);
+        *verify = ZPACK_FALSE;
+    }
+#endif
+#endif
+
+    return ZPACK_OK;
+}
+
+void zpack_end_verify(zpack_reader* reader, zpack_file_entry* entry)
+{
+    if (!reader->verified_entries || entry < reader->file_entries || entry >= reader->file_entries + reader->file_count)
+        return;
+
+#ifdef ZPACK_HAVE_ATOMICS
+    zpack_u64 index = entry - reader->file_entries;
+    zpack_atomic_or_u32(reader->verified_entries + ZPACK_BITMAP_WORD(index), ZPACK_BITMAP_BIT(index));
+#endif
+}
+
+void zpack_flush_verifier(zpack_reader* reader)
+{
+#ifdef ZPACK_HAVE_BACKGROUND_VERIFY
+    zpack_verifier* verifier = (zpack_verifier*)reader->verifier;
+    if (!verifier) return;
+
+    zpack_mutex_lock(&verifier->mutex);
+    while (verifier->count || verifier->busy)
+        zpack_cond_wait(&verifier->idle_cond, &verifier->mutex);
+    zpack_mutex_unlock(&verifier->mutex);
+#endif
+}
+
+void zpack_free_verifier(zpack_reader* reader)
+{
+#ifdef ZPACK_HAVE_BACKGROUND_VERIFY
+    zpack_verifier* verifier = (zpack_verifier*)reader->verifier;
+    if (verifier)
+    {
+        zpack_mutex_lock(&verifier->mutex);
+        verifier->stop = ZPACK_TRUE;
+        zpack_cond_signal(&verifier->cond);
+        zpack_mutex_unlock(&verifier->mutex);
+
+        zpack_thread_join(verifier->thread);
+        zpack_cond_destroy(&verifier->idle_cond);
+        zpack_cond_destroy(&verifier->cond);
+        zpack_mutex_destroy(&verifier->mutex);
+        free(verifier->queued_entries);
+        free(verifier);
+    }
+#endif
+
+    free((void*)reader->verified_entries);
+    free((void*)reader->corrupted_entries);
+    reader->verifier = NULL;
+    reader->verified_entries = NULL;
+    reader->corrupted_entries = NULL;
+}
@@ -256,7 +256,7 @@ static int zpack_add_written_file_entry(zpack_writer* writer, zpack_file* file,
     entry->hash = XXH3_64bits(file->buffer, file->size);
     entry->comp_method = file->options->method;
 
-    return ZPACK_OK;
+    return zpack_add_file_index_entry(&writer->file_index, writer->file_entries, writer->file_count - 1);
 }
 
 static int zpack_copy_file_entry(zpack_writer* writer, zpack_file_entry* src_entry, zpack_u64 new_offset)
@@ -274,7 +274,7 @@ static int zpack_copy_file_entry(zpack_writer* writer, zpack_file_entry* src_ent
 
     entry->offset = new_offset;
 
-    return ZPACK_OK;
+    return zpack_add_file_index_entry(&writer->file_index, writer->file_entries, writer->file_count - 1);
 }
 
 int zpack_write_files(zpack_writer* writer, zpack_file* files, zpack_u64 file_count)
@@ -351,7 +351,7 @@ int zpack_write_files_from_archive(zpack_writer* writer, zpack_reader* reader, z
     int ret;
     for (zpack_u64 i = 0; i < file_count; ++i)
     {
-        if (reader->file)
+        if (ZPACK_READER_HAS_IO(reader))
         {
             if (buffer_capacity < entries[i].comp_size)
             {
@@ -681,7 +681,7 @@ int zpack_write_file_stream_end(zpack_writer* writer, char* filename, zpack_comp
     entry->comp_method = options->method;
 
     XXH3_64bits_reset(stream->xxh3_state);
-    return ZPACK_OK;
+    return zpack_add_file_index_entry(&writer->file_index, writer->file_entries, writer->file_count - 1);
 }
 
 static void zpack_write_cdr_memory(zpack_u8* p, zpack_file_entry* entries, zpack_u64 file_count, zpack_u16* fn_lengths, zpack_u64 block_size)
@@ -842,6 +842,7 @@ void zpack_close_writer(zpack_writer* writer)
 
         free(writer->file_entries);
     }
+    zpack_free_file_index(&writer->file_index);
 
     // compression contexts
 #ifndef ZPACK_DISABLE_ZSTD
@@ -100,7 +100,8 @@ static int write_files(zpack_writer* writer, args_options* options, zpack_compre
         printf("  %s\n", files[i].filename);
 
         // check if file already exists
-        if (zpack_get_file_entry(files[i].filename, writer->file_entries, writer->file_count))
+        if (zpack_get_file_entry_indexed(files[i].filename, strlen(files[i].filename), &writer->file_index,
+                                         writer->file_entries))
         {
             printf("Warning: File already exists in archive, ignoring\n");
             continue;
@@ -302,28 +303,8 @@ int command_add(args_options* options)
     return 0;
 }
 
-static int init_decompress_stream(zpack_stream* stream)
-{
-    zpack_init_stream(stream);
-
-    stream->avail_in = zpack_get_dstream_in_size(ZPACK_COMPRESSION_NONE);
-    stream->next_in = (zpack_u8*)malloc(sizeof(zpack_u8) * stream->avail_in);
-
-    stream->avail_out = zpack_get_dstream_out_size(ZPACK_COMPRESSION_NONE);
-    stream->next_out = (zpack_u8*)malloc(sizeof(zpack_u8) * stream->avail_out);
-
-    if (stream->next_in == NULL || stream->next_out == NULL)
-    {
-        printf("Error: Failed to allocate memory\n");
-        free(stream->next_in);
-        free(stream->next_out);
-        return 1;
-    }
-
-    return 0;
-}
-
-static int extract_file(zpack_reader* reader, zpack_stream* stream, zpack_file_entry* entry, const char* filename, const char* output)
+static int extract_file(zpack_reader* reader, zpack_entry_stream* stream, zpack_u8* out_buf, size_t out_size,
+                        zpack_file_entry* entry, const char* filename, const char* output)
 {
     size_t output_length = output ? strlen(output) : 0;
     size_t fn_length = strlen(filename);
@@ -353,19 +334,20 @@ static int extract_file(zpack_reader* reader, zpack_stream* stream, zpack_file_e
         return 1;
     }
 
-    zpack_u8* in_buf = stream->next_in;
-    zpack_u8* out_buf = stream->next_out;
-    size_t in_size = stream->avail_in;
-    size_t out_size = stream->avail_out;
-
-    // Reset stream
-    zpack_reset_stream(stream);
-
     printf("  %s\n", entry->filename);
     int ret;
-    for (;;)
+    if ((ret = zpack_entry_stream_open(stream, reader, entry, NULL)))
+    {
+        printf("Error: Failed to extract \"%s\" (error %d)\n", entry->filename, ret);
+        free(path);
+        ZPACK_FCLOSE(fp);
+        return 1;
+    }
+
+    while (!stream->done)
     {
-        if ((ret = zpack_read_file_stream(reader, entry, stream, NULL)))
+        size_t write_size;
+        if ((ret = zpack_entry_stream_read(stream, out_buf, out_size, &write_size)))
         {
             if (ret == ZPACK_ERROR_FILE_HASH_MISMATCH)
                 printf("Warning: File is corrupted (file hash mismatch)\n");
@@ -378,7 +360,6 @@ static int extract_file(zpack_reader* reader, zpack_stream* stream, zpack_file_e
             }
         }
 
-        size_t write_size = stream->next_out - out_buf;
         if (ZPACK_FWRITE(out_buf, 1, write_size, fp) != write_size)
         {
             printf("Error: Failed to write data to \"%s\"", path);
@@ -386,20 +367,6 @@ static int extract_file(zpack_reader* reader, zpack_stream* stream, zpack_file_e
             ZPACK_FCLOSE(fp);
             return 1;
         }
-
-        // Reset buffers
-        // The input buffer might not be fully decompressed in one go, in which case
-        // we need to copy what's left to continue decompressing.
-        // ZPack expects that data to be at the beginning of the next buffer.
-        if (stream->read_back)
-            memmove(in_buf, stream->next_in - stream->read_back, stream->read_back);
-        stream->next_in = in_buf;
-        stream->avail_in = in_size;
-
-        stream->next_out = out_buf;
-        stream->avail_out = out_size;
-
-        if (ZPACK_READ_STREAM_DONE(stream, entry)) break;
     }
 
     if (stream->total_out != entry->uncomp_size)
@@ -427,12 +394,16 @@ static int extract_files_i(args_options* options, zpack_bool full_path)
     }
     printf("-- Found %" PRIu64 " files\n", reader.file_count);
 
-    zpack_stream stream;
-    memset(&stream, 0, sizeof(zpack_stream));
-    if ((ret = init_decompress_stream(&stream)))
-        return ret;
-    zpack_u8* in_buf = stream.next_in;
-    zpack_u8* out_buf = stream.next_out;
+    zpack_entry_stream stream;
+    memset(&stream, 0, sizeof(zpack_entry_stream));
+    size_t out_size = zpack_get_dstream_out_size(ZPACK_COMPRESSION_NONE);
+    zpack_u8* out_buf = (zpack_u8*)malloc(sizeof(zpack_u8) * out_size);
+    if (out_buf == NULL)
+    {
+        printf("Error: Failed to allocate memory\n");
+        zpack_close_reader(&reader);
+        return 1;
+    }
 
     printf("-- Extracting files...\n");
     int error_count = 0;
@@ -465,9 +436,10 @@ static int extract_files_i(args_options* options, zpack_bool full_path)
                 utils_process_path(entry->filename, fn_buf);
             }
             else fn_buf = entry->filename;
-            ret = extract_file(&reader, &stream, entry, fn_buf, options->output);
+            ret = extract_file(&reader, &stream, out_buf, out_size, entry, fn_buf, options->output);
         }
-        else ret = extract_file(&reader, &stream, entry, utils_get_filename(entry->filename, 0), options->output);
+        else ret = extract_file(&reader, &stream, out_buf, out_size, entry, utils_get_filename(entry->filename, 0),
+                               options->output);
 
         if (ret)
         {
@@ -479,9 +451,8 @@ static int extract_files_i(args_options* options, zpack_bool full_path)
     if (error_count) printf("-- Errors: %d\n", error_count);
     printf("-- Done.\n");
 	if (!options->unsafe) free(fn_buf);
-    free(in_buf);
     free(out_buf);
-    zpack_close_stream(&stream);
+    zpack_entry_stream_close(&stream);
     zpack_close_reader(&reader);
     return 0;
 }
@@ -506,6 +477,9 @@ int command_list(args_options* options)
     zpack_reader reader;
     memset(&reader, 0, sizeof(zpack_reader));
 
+    // entries are read on demand
+    reader.flags = ZPACK_READER_SKIP_FILE_ENTRIES;
+
     int ret;
     if ((ret = zpack_init_reader(&reader, archive_path)))
     {
@@ -514,12 +488,31 @@ int command_list(args_options* options)
         return 1;
     }
 
+    zpack_cdr_iterator iterator;
+    if ((ret = zpack_init_cdr_iterator(&iterator, &reader, 0)))
+    {
+        printf("Error: Failed to read CDR (error %d)\n", ret);
+        zpack_close_cdr_iterator(&iterator);
+        zpack_close_reader(&reader);
+        return 1;
+    }
+
     printf("%12s %12s %8s  %s\n" ROW_SEPARATOR, "Size", "Compressed", "Method", "Name");
-    for (zpack_u64 i = 0; i < reader.file_count; ++i)
+    zpack_u64 uncomp_size = 0;
+    zpack_u64 comp_size = 0;
+    while (!ZPACK_CDR_ITERATOR_DONE(&iterator))
     {
-        zpack_file_entry* entry = reader.file_entries + i;
+        zpack_file_entry entry;
+        if ((ret = zpack_next_cdr_entry(&iterator, &entry)))
+        {
+            printf("Error: Failed to read file entry (error %d)\n", ret);
+            zpack_close_cdr_iterator(&iterator);
+            zpack_close_reader(&reader);
+            return 1;
+        }
+
         char* method;
-        switch (entry->comp_method)
+        switch (entry.comp_method)
         {
         case ZPACK_COMPRESSION_NONE:
             method = "none";
@@ -538,11 +531,14 @@ int command_list(args_options* options)
             break;
 
         }
-        PRINT_LIST_ROW(entry->uncomp_size, entry->comp_size, method, entry->filename);
+        PRINT_LIST_ROW(entry.uncomp_size, entry.comp_size, method, entry.filename);
+        uncomp_size += entry.uncomp_size;
+        comp_size += entry.comp_size;
     }
     printf(ROW_SEPARATOR "%12" PRIu64 " %12" PRIu64 " %8s  %" PRIu64 " files\n",
-           reader.uncomp_size, reader.comp_size, "", reader.file_count);
+           uncomp_size, comp_size, "", iterator.count);
 
+    zpack_close_cdr_iterator(&iterator);
     zpack_close_reader(&reader);
     return 0;
 }
@@ -653,14 +649,14 @@ int command_move(args_options* options)
     for (zpack_u64 i = 0; i < reader.file_count; ++i)
     {
         zpack_file_entry* entry = reader.file_entries + i;
+        char* filename = entry->filename;
         zpack_bool moved = ZPACK_FALSE;
         for (int x = 1; x < options->path_count; x += 2)
         {
             if (strcmp(options->path_list[x], entry->filename) == 0)
             {
                 printf("  %s -> %s\n", options->path_list[x], options->path_list[x + 1]);
-                // free the original filename
-                free(entry->filename);
+                // the original filename is owned by the reader's string arena
                 entry->filename = options->path_list[x + 1];
 
                 moved = ZPACK_TRUE;
@@ -678,7 +674,7 @@ int command_move(args_options* options)
             return 1;
         }
 
-        if (moved) entry->filename = NULL;
+        if (moved) entry->filename = filename;
     }
 
     if (!file_moved)
@@ -720,14 +716,16 @@ int command_test(args_options* options)
     }
     printf("-- Found %" PRIu64 " files\n", reader.file_count);
 
-    zpack_stream stream;
-    memset(&stream, 0, sizeof(zpack_stream));
-    if ((ret = init_decompress_stream(&stream)))
-        return ret;
-    zpack_u8* in_buf = stream.next_in;
-    zpack_u8* out_buf = stream.next_out;
-    size_t in_size = stream.avail_in;
-    size_t out_size = stream.avail_out;
+    zpack_entry_stream stream;
+    memset(&stream, 0, sizeof(zpack_entry_stream));
+    size_t out_size = zpack_get_dstream_out_size(ZPACK_COMPRESSION_NONE);
+    zpack_u8* out_buf = (zpack_u8*)malloc(sizeof(zpack_u8) * out_size);
+    if (out_buf == NULL)
+    {
+        printf("Error: Failed to allocate memory\n");
+        zpack_close_reader(&reader);
+        return 1;
+    }
 
     printf("-- Testing files...\n");
     zpack_u64 corrupt_count = 0;
@@ -736,39 +734,32 @@ int command_test(args_options* options)
         zpack_file_entry* entry = reader.file_entries + i;
         printf("  %s\n", entry->filename);
 
-        // Reset stream
-        stream.total_out = 0;
-        stream.total_in = 0;
-        for (;;)
+        ret = zpack_entry_stream_open(&stream, &reader, entry, NULL);
+        while (!ret && !stream.done)
         {
-            if ((ret = zpack_read_file_stream(&reader, entry, &stream, NULL)))
-            {
-                if (ret == ZPACK_ERROR_FILE_HASH_MISMATCH)
-                {
-                    printf("-- File is corrupted!\n");
-                    ++corrupt_count;
-                    break;
-                }
-                
-                printf("Error: Failed to decompress \"%s\" (error %d)\n", entry->filename, ret);
-                zpack_close_reader(&reader);
-                return 1;
-            }
-
-            if (stream.read_back)
-                memmove(in_buf, stream.next_in - stream.read_back, stream.read_back);
-            stream.next_in = in_buf;
-            stream.avail_in = in_size;
-
-            stream.next_out = out_buf;
-            stream.avail_out = out_size;
+            size_t read_size;
+            ret = zpack_entry_stream_read(&stream, out_buf, out_size, &read_size);
+        }
 
-            if (ZPACK_READ_STREAM_DONE(&stream, entry)) break;
+        if (ret == ZPACK_ERROR_FILE_HASH_MISMATCH)
+        {
+            printf("-- File is corrupted!\n");
+            ++corrupt_count;
+        }
+        else if (ret)
+        {
+            printf("Error: Failed to decompress \"%s\" (error %d)\n", entry->filename, ret);
+            free(out_buf);
+            zpack_entry_stream_close(&stream);
+            zpack_close_reader(&reader);
+            return 1;
         }
     }
 
     printf("-- Done.\n"
            "-- Corrupted files: %" PRIu64 "/%" PRIu64 "\n", corrupt_count, reader.file_count);
+    free(out_buf);
+    zpack_entry_stream_close(&stream);
     zpack_close_reader(&reader);
     return 0;
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 #include <inttypes.h>
 #endif
 
+#define SIDECAR_NAME "out_sidecar.zpk.idx"
+
 zpack_bool print_and_verify_archive(zpack_reader* reader)
 {
     zpack_file_entry* entries = reader->file_entries;
@@ -38,12 +40,93 @@ zpack_bool print_and_verify_archive(zpack_reader* reader)
         passed = passed ? entry_passed : ZPACK_FALSE;
     }
 
+    // indexed lookups
+    for (zpack_u64 i = 0; i < reader->file_count; ++i)
+    {
+        // names don't need to be null terminated
+        char name[32];
+        size_t length = strlen(_filenames[i]);
+        memcpy(name, _filenames[i], length);
+        memcpy(name + length, "XYZ", 4);
+
+        zpack_file_entry* entry = zpack_get_file_entry_indexed(name, length, &reader->file_index, entries);
+        zpack_bool lookup_passed = (entry == entries + i);
+        printf("Indexed lookup of %s %s\n", _filenames[i], lookup_passed ? "passed" : "failed");
+        passed = passed ? lookup_passed : ZPACK_FALSE;
+    }
+    if (zpack_get_file_entry_indexed("file3.txt", 9, &reader->file_index, entries) != NULL)
+    {
+        printf("Indexed lookup of a missing file returned an entry\n");
+        passed = ZPACK_FALSE;
+    }
+    printf("\n");
+
     if (passed) printf("-- (GOOD) All entries are valid\n\n");
     else printf("-- (BAD) One or more entries are invalid\n\n");
 
     return passed;
 }
 
+zpack_bool iterate_and_verify_archive(zpack_reader* reader)
+{
+    zpack_cdr_iterator iterator;
+    int ret;
+    if ((ret = zpack_init_cdr_iterator(&iterator, reader, 0)))
+    {
+        printf("Failed to init CDR iterator (error %d)\n", ret);
+        return ZPACK_FALSE;
+    }
+
+    zpack_bool passed = (iterator.count == FILE_COUNT);
+    while (!ZPACK_CDR_ITERATOR_DONE(&iterator))
+    {
+        zpack_u64 i = iterator.index;
+        zpack_file_entry entry;
+        if ((ret = zpack_next_cdr_entry(&iterator, &entry)))
+        {
+            printf("Failed to read entry %" PRIu64 " (error %d)\n", i, ret);
+            passed = ZPACK_FALSE;
+            break;
+        }
+
+        zpack_bool entry_passed = (
+            strcmp(entry.filename, _filenames[i]) == 0 &&
+            entry.uncomp_size == _uncomp_sizes[i] &&
+            entry.hash == _hashes[i]
+        );
+        printf("-- %s is %s\n", entry.filename, entry_passed ? "valid" : "invalid");
+        passed = passed ? entry_passed : ZPACK_FALSE;
+    }
+
+    zpack_close_cdr_iterator(&iterator);
+    return passed;
+}
+
+zpack_bool verify_entry_table(zpack_reader* reader)
+{
+    zpack_entry_table* table = &reader->entry_table;
+    zpack_bool passed = (table->count == FILE_COUNT);
+    for (zpack_u64 i = 0; i < table->count; ++i)
+    {
+        zpack_file_entry entry;
+        zpack_get_entry_view(table, i, &entry);
+
+        zpack_u64 found;
+        zpack_bool entry_passed = (
+            strcmp(ZPACK_ENTRY_TABLE_NAME(table, i), _filenames[i]) == 0 &&
+            zpack_find_table_entry(table, _filenames[i], strlen(_filenames[i]), &found) == ZPACK_OK &&
+            strcmp(ZPACK_ENTRY_TABLE_NAME(table, found), _filenames[i]) == 0 &&
+            entry.filename == ZPACK_ENTRY_TABLE_NAME(table, i) &&
+            table->uncomp_sizes[i] == _uncomp_sizes[i] && entry.uncomp_size == _uncomp_sizes[i] &&
+            table->hashes[i] == _hashes[i] && entry.hash == _hashes[i]
+        );
+        printf("-- %s is %s\n", entry.filename, entry_passed ? "valid" : "invalid");
+        passed = passed ? entry_passed : ZPACK_FALSE;
+    }
+
+    return passed;
+}
+
 int open_archive(int num)
 {
     printf("Archive #%d\n"
@@ -65,6 +148,26 @@ int open_archive(int num)
     zpack_bool passed1 = print_and_verify_archive(&reader);
     zpack_close_reader(&reader);
 
+    // read the end of the file at once, with a window larger than the file and one that only
+    // holds the EOCDR
+    printf("Tail read test\n");
+
+    zpack_bool passed_tail = ZPACK_TRUE;
+    for (int i = 0; i < 2; ++i)
+    {
+        reader.flags = ZPACK_READER_TAIL_READ | (i ? ZPACK_READER_ENTRY_TABLE : 0);
+        reader.tail_read_size = i ? ZPACK_EOCDR_SIZE : 0;
+        if ((ret = zpack_init_reader(&reader, _archive_names[num])))
+        {
+            printf("Error %d\n", ret);
+            return 1;
+        }
+
+        passed_tail = passed_tail && print_and_verify_archive(&reader) && reader.cdr_buffer == NULL &&
+                      (!i || verify_entry_table(&reader));
+        zpack_close_reader(&reader);
+    }
+
     // read from buffer
     printf("Buffer read test\n");
 
@@ -91,8 +194,518 @@ int open_archive(int num)
     zpack_bool passed3 = print_and_verify_archive(&reader);
     zpack_close_reader(&reader);
 
+    // read from memory mapped file
+    printf("Mapped read test\n");
+
+    if ((ret = zpack_init_reader_mmap(&reader, _archive_names[num])))
+    {
+        printf("Error %d\n", ret);
+        return 1;
+    }
+
+    zpack_bool passed4 = print_and_verify_archive(&reader);
+    zpack_close_reader(&reader);
+
+    // read entries on demand
+    printf("Iterator test\n");
+
+    reader.flags = ZPACK_READER_SKIP_FILE_ENTRIES;
+    if ((ret = zpack_init_reader(&reader, _archive_names[num])))
+    {
+        printf("Error %d\n", ret);
+        return 1;
+    }
+
+    zpack_bool passed5 = reader.file_entries == NULL && iterate_and_verify_archive(&reader);
+    zpack_close_reader(&reader);
+
+    // compact entry table only
+    printf("Entry table test\n");
+
+    reader.flags = ZPACK_READER_SKIP_FILE_ENTRIES | ZPACK_READER_ENTRY_TABLE;
+    if ((ret = zpack_init_reader(&reader, _archive_names[num])))
+    {
+        printf("Error %d\n", ret);
+        return 1;
+    }
+
+    zpack_u64 found;
+    zpack_bool passed6 = reader.file_entries == NULL && verify_entry_table(&reader) &&
+                         zpack_find_table_entry(&reader.entry_table, "missing", 7, &found) == ZPACK_ERROR_FILE_NOT_FOUND;
+
+    // sidecar index
+    printf("Sidecar index test\n");
+
+    if ((ret = zpack_write_sidecar_index(&reader, SIDECAR_NAME)))
+    {
+        printf("Error %d\n", ret);
+        zpack_close_reader(&reader);
+        return 1;
+    }
+    zpack_close_reader(&reader);
+
+    reader.flags = ZPACK_READER_SKIP_FILE_ENTRIES | ZPACK_READER_ENTRY_TABLE;
+    reader.sidecar_path = SIDECAR_NAME;
+    if ((ret = zpack_init_reader(&reader, _archive_names[num])))
+    {
+        printf("Error %d\n", ret);
+        return 1;
+    }
+    zpack_bool passed7 = reader.sidecar != NULL && verify_entry_table(&reader);
+    zpack_close_reader(&reader);
+
+    reader.flags = ZPACK_READER_ENTRY_TABLE;
+    reader.sidecar_path = SIDECAR_NAME;
+    if ((ret = zpack_init_reader_mmap(&reader, _archive_names[num])))
+    {
+        printf("Error %d\n", ret);
+        return 1;
+    }
+    passed7 = passed7 && reader.sidecar != NULL && verify_entry_table(&reader);
+
+    // rewriting the sidecar while it's mapped (the table is written from the mapping itself) leaves the mapping intact
+    ret = zpack_write_sidecar_index(&reader, SIDECAR_NAME);
+#ifdef _WIN32
+    passed7 = passed7 && ret == ZPACK_ERROR_WRITE_FAILED && verify_entry_table(&reader);
+#else
+    passed7 = passed7 && ret == ZPACK_OK && verify_entry_table(&reader);
+#endif
+    zpack_close_reader(&reader);
+
+    reader.flags = ZPACK_READER_SKIP_FILE_ENTRIES | ZPACK_READER_ENTRY_TABLE;
+    reader.sidecar_path = SIDECAR_NAME;
+    if ((ret = zpack_init_reader(&reader, _archive_names[num])))
+    {
+        printf("Error %d\n", ret);
+        return 1;
+    }
+    passed7 = passed7 && reader.sidecar != NULL && verify_entry_table(&reader);
+    zpack_close_reader(&reader);
+
+    // a sidecar written for another archive is ignored
+    reader.flags = ZPACK_READER_SKIP_FILE_ENTRIES | ZPACK_READER_ENTRY_TABLE;
+    reader.sidecar_path = SIDECAR_NAME;
+    if ((ret = zpack_init_reader(&reader, _archive_names[(num + 1) % ARCHIVE_COUNT])))
+    {
+        printf("Error %d\n", ret);
+        return 1;
+    }
+    passed7 = passed7 && reader.sidecar == NULL && reader.entry_table.count == FILE_COUNT &&
+              zpack_map_sidecar_index(&reader, SIDECAR_NAME) == ZPACK_ERROR_FILE_HASH_MISMATCH;
+    zpack_close_reader(&reader);
+    printf("Sidecar index is %s\n\n", passed7 ? "valid" : "invalid");
+
     // 0 if passed, 1 if failed
-    return !(passed1 && passed2 && passed3);
+    return !(passed1 && passed_tail && passed2 && passed3 && passed4 && passed5 && passed6 && passed7);
+}
+
+#define LARGE_FILE_COUNT 16384
+#define LARGE_ARCHIVE_NAME "out_large.zpk"
+static void get_large_filename(char* buffer, int i)
+{
+    sprintf(buffer, "directory_%02d/some_long_file_name_%05d.txt", i % 16, i);
+}
+
+typedef struct list_counts_s
+{
+    int files;
+    int dirs;
+    zpack_u32 file_depth;
+    zpack_bool valid;
+
+} list_counts;
+
+static int count_dir_entry(const zpack_dir_entry* entry, void* user_data)
+{
+    list_counts* counts = (list_counts*)user_data;
+    if (entry->file)
+    {
+        // files are listed with their name only
+        const char* basename = strrchr(entry->file->filename, '/');
+        if (strcmp(basename ? basename + 1 : entry->file->filename, entry->name) != 0 || entry->depth != counts->file_depth)
+            counts->valid = ZPACK_FALSE;
+        ++counts->files;
+    }
+    else
+        ++counts->dirs;
+    return 0;
+}
+
+// "name:depth," for every item, directories end with a '/'
+typedef struct list_output_s
+{
+    char buffer[256];
+    size_t size;
+    zpack_bool valid;
+
+} list_output;
+
+static int append_dir_entry(const zpack_dir_entry* entry, void* user_data)
+{
+    list_output* output = (list_output*)user_data;
+    if (entry->file)
+    {
+        const char* basename = strrchr(entry->file->filename, '/');
+        if (strcmp(basename ? basename + 1 : entry->file->filename, entry->name) != 0)
+            output->valid = ZPACK_FALSE;
+    }
+
+    int written = snprintf(output->buffer + output->size, sizeof(output->buffer) - output->size, "%s%s:%u,",
+                           entry->name, entry->file ? "" : "/", entry->depth);
+    if (written < 0 || (size_t)written >= sizeof(output->buffer) - output->size)
+    {
+        output->valid = ZPACK_FALSE;
+        return 1;
+    }
+
+    output->size += written;
+    return 0;
+}
+
+static zpack_bool check_dir_listing(zpack_reader* reader, const char* path, zpack_bool recursive, const char* expected)
+{
+    list_output output;
+    memset(&output, 0, sizeof(output));
+    output.valid = ZPACK_TRUE;
+
+    int ret = zpack_list_dir(reader, path, recursive, append_dir_entry, &output);
+    zpack_bool passed = ret == ZPACK_OK && output.valid && strcmp(output.buffer, expected) == 0;
+    printf("-- Listed %s%s: %s (error %d)\n", path, recursive ? " recursively" : "", passed ? "passed" : "failed", ret);
+    if (!passed) printf("   got \"%s\", expected \"%s\"\n", output.buffer, expected);
+    return passed;
+}
+
+#define NESTED_ARCHIVE_NAME "out_nested.zpk"
+#define NESTED_FILE_COUNT 7
+static const char* _nested_filenames[NESTED_FILE_COUNT] = {
+    "root.txt",
+    "a/b/c/file.txt",
+    "a/b/top.txt",
+    "a/b/d/file.txt",
+    "a/b/c/e/deep.txt",
+    "a/b/c/other.txt",
+    "a/sibling.txt"
+};
+
+// directory listings of an archive with several levels of nesting
+int open_nested_archive()
+{
+    printf("Nested archive\n"
+           "----------------------\n");
+
+    zpack_writer writer;
+    memset(&writer, 0, sizeof(writer));
+    int ret;
+    if ((ret = zpack_init_writer(&writer, NESTED_ARCHIVE_NAME)))
+    {
+        printf("Failed to open writer (error %d)\n", ret);
+        return 1;
+    }
+
+    zpack_compress_options options = { ZPACK_COMPRESSION_NONE, 0 };
+    zpack_file files[NESTED_FILE_COUNT];
+    memset(files, 0, sizeof(files));
+    for (int i = 0; i < NESTED_FILE_COUNT; ++i)
+    {
+        files[i].filename = (char*)_nested_filenames[i];
+        files[i].buffer = (zpack_u8*)_nested_filenames[i];
+        files[i].size = strlen(_nested_filenames[i]);
+        files[i].options = &options;
+    }
+    ret = zpack_write_archive(&writer, files, NESTED_FILE_COUNT);
+    zpack_close_writer(&writer);
+    if (ret)
+    {
+        printf("Failed to write archive (error %d)\n", ret);
+        return 1;
+    }
+
+    zpack_reader reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.flags = ZPACK_READER_DIRECTORY_INDEX;
+    if ((ret = zpack_init_reader(&reader, NESTED_ARCHIVE_NAME)))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        return 1;
+    }
+
+    // files come before subdirectories, subdirectories are walked depth first
+    zpack_bool passed = check_dir_listing(&reader, "a/b", ZPACK_FALSE, "top.txt:0,c/:0,d/:0,");
+    passed = check_dir_listing(&reader, "a/b", ZPACK_TRUE,
+                               "top.txt:0,c/:0,d/:0,file.txt:1,other.txt:1,e/:1,deep.txt:2,file.txt:1,") && passed;
+    passed = check_dir_listing(&reader, "/a/b/c/", ZPACK_FALSE, "file.txt:0,other.txt:0,e/:0,") && passed;
+    passed = check_dir_listing(&reader, "a/b/c/e", ZPACK_TRUE, "deep.txt:0,") && passed;
+    passed = check_dir_listing(&reader, "a", ZPACK_FALSE, "sibling.txt:0,b/:0,") && passed;
+
+    // files aren't directories
+    ret = zpack_list_dir(&reader, "a/b/top.txt", ZPACK_FALSE, append_dir_entry, NULL);
+    passed = passed && ret == ZPACK_ERROR_FILE_NOT_FOUND;
+
+    zpack_close_reader(&reader);
+    return !passed;
+}
+
+static zpack_read_request* requests_base;
+static void on_file_read(zpack_read_request* request, void* user_data)
+{
+    zpack_bool* done = (zpack_bool*)user_data;
+    done[request - requests_base] = (request->result == ZPACK_OK);
+}
+
+// archive with a CDR that doesn't fit in a single iterator window
+int open_large_archive()
+{
+    printf("Large archive\n"
+           "----------------------\n");
+
+    zpack_writer writer;
+    memset(&writer, 0, sizeof(writer));
+    int ret;
+    if ((ret = zpack_init_writer(&writer, LARGE_ARCHIVE_NAME)))
+    {
+        printf("Failed to open writer (error %d)\n", ret);
+        return 1;
+    }
+
+    zpack_compress_options options = { ZPACK_COMPRESSION_NONE, 0 };
+    zpack_file* files = (zpack_file*)calloc(LARGE_FILE_COUNT, sizeof(zpack_file));
+    char (*names)[64] = malloc(sizeof(*names) * LARGE_FILE_COUNT);
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+    {
+        get_large_filename(names[i], i);
+        files[i].filename = names[i];
+        files[i].buffer = (zpack_u8*)names[i];
+        files[i].size = strlen(names[i]);
+        files[i].options = &options;
+    }
+    ret = zpack_write_archive(&writer, files, LARGE_FILE_COUNT);
+    zpack_close_writer(&writer);
+    free(files);
+    if (ret)
+    {
+        printf("Failed to write archive (error %d)\n", ret);
+        free(names);
+        return 1;
+    }
+
+    zpack_bool passed = ZPACK_TRUE;
+    zpack_reader reader;
+    memset(&reader, 0, sizeof(reader));
+
+    // iterate with the smallest window possible
+    reader.flags = ZPACK_READER_SKIP_FILE_ENTRIES;
+    zpack_cdr_iterator iterator;
+    if ((ret = zpack_init_reader(&reader, LARGE_ARCHIVE_NAME)) ||
+        (ret = zpack_init_cdr_iterator(&iterator, &reader, 1)))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        free(names);
+        return 1;
+    }
+    while (!ZPACK_CDR_ITERATOR_DONE(&iterator))
+    {
+        zpack_u64 i = iterator.index;
+        zpack_file_entry entry;
+        if ((ret = zpack_next_cdr_entry(&iterator, &entry)) || strcmp(entry.filename, names[i]) != 0)
+        {
+            printf("Entry %" PRIu64 " is invalid (error %d)\n", i, ret);
+            passed = ZPACK_FALSE;
+            break;
+        }
+    }
+    printf("-- Iterated %" PRIu64 "/%d entries\n", iterator.index, LARGE_FILE_COUNT);
+    passed = passed && iterator.index == LARGE_FILE_COUNT;
+    zpack_close_cdr_iterator(&iterator);
+    zpack_close_reader(&reader);
+
+    // indexed lookups
+    reader.flags = ZPACK_READER_DIRECTORY_INDEX;
+    if ((ret = zpack_init_reader(&reader, LARGE_ARCHIVE_NAME)))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        free(names);
+        return 1;
+    }
+    zpack_u64 found = 0;
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+    {
+        zpack_file_entry* entry = zpack_get_file_entry_indexed(names[i], strlen(names[i]), &reader.file_index,
+                                                               reader.file_entries);
+        if (entry == reader.file_entries + i) ++found;
+    }
+    printf("-- Found %" PRIu64 "/%d entries using the index\n", found, LARGE_FILE_COUNT);
+    passed = passed && found == LARGE_FILE_COUNT;
+
+    // parsing the CDR on multiple threads gives the same entries and index
+    for (int mmap = 0; mmap < 2; ++mmap)
+    {
+        zpack_reader parallel_reader;
+        memset(&parallel_reader, 0, sizeof(parallel_reader));
+        parallel_reader.parse_thread_count = 4;
+        parallel_reader.flags = mmap ? 0 : ZPACK_READER_TAIL_READ; // the CDR doesn't fit in the default window
+        ret = mmap ? zpack_init_reader_mmap(&parallel_reader, LARGE_ARCHIVE_NAME) :
+                     zpack_init_reader(&parallel_reader, LARGE_ARCHIVE_NAME);
+
+        zpack_u64 matched = 0;
+        for (zpack_u64 i = 0; ret == ZPACK_OK && i < parallel_reader.file_count; ++i)
+        {
+            zpack_file_entry* entry = parallel_reader.file_entries + i;
+            if (strcmp(entry->filename, reader.file_entries[i].filename) == 0 &&
+                entry->offset == reader.file_entries[i].offset && entry->hash == reader.file_entries[i].hash &&
+                zpack_get_file_entry_indexed(names[i], strlen(names[i]), &parallel_reader.file_index,
+                                             parallel_reader.file_entries) == entry)
+                ++matched;
+        }
+        printf("-- Parsed %" PRIu64 "/%d entries on multiple threads%s (error %d)\n", matched, LARGE_FILE_COUNT,
+               mmap ? " from a mapped file" : "", ret);
+        passed = passed && ret == ZPACK_OK && matched == LARGE_FILE_COUNT &&
+                 parallel_reader.file_index.count == reader.file_index.count &&
+                 parallel_reader.comp_size == reader.comp_size && parallel_reader.uncomp_size == reader.uncomp_size;
+        zpack_close_reader(&parallel_reader);
+    }
+
+    // clones share the entries and the index, and can outlive the source
+    zpack_reader clones[2];
+    ret = zpack_clone_reader(&clones[0], &reader, LARGE_ARCHIVE_NAME);
+    if (ret == ZPACK_OK) ret = zpack_clone_reader(&clones[1], &clones[0], LARGE_ARCHIVE_NAME);
+    zpack_u64 cloned = 0;
+    for (int i = 0; ret == ZPACK_OK && i < LARGE_FILE_COUNT; ++i)
+    {
+        zpack_file_entry* entry = zpack_get_file_entry_indexed(names[i], strlen(names[i]), &clones[i % 2].file_index,
+                                                               clones[i % 2].file_entries);
+        if (entry == reader.file_entries + i && clones[i % 2].file != reader.file) ++cloned;
+    }
+    printf("-- Found %" PRIu64 "/%d entries using clones of the reader (error %d)\n", cloned, LARGE_FILE_COUNT, ret);
+    passed = passed && ret == ZPACK_OK && cloned == LARGE_FILE_COUNT;
+    if (ret == ZPACK_OK)
+    {
+        zpack_close_reader(&clones[0]);
+
+        char content[64] = { 0 };
+        zpack_file_entry* entry = clones[1].file_entries + LARGE_FILE_COUNT - 1;
+        ret = zpack_read_file(&clones[1], entry, (zpack_u8*)content, sizeof(content) - 1, NULL);
+        passed = passed && ret == ZPACK_OK && strcmp(content, names[LARGE_FILE_COUNT - 1]) == 0;
+        zpack_close_reader(&clones[1]);
+    }
+
+    // directory listings
+    list_counts counts = { 0, 0, 0, ZPACK_TRUE };
+    ret = zpack_list_dir(&reader, "directory_03/", ZPACK_FALSE, count_dir_entry, &counts);
+    printf("-- Listed %d files in directory_03 (error %d)\n", counts.files, ret);
+    passed = passed && ret == ZPACK_OK && counts.valid && counts.files == LARGE_FILE_COUNT / 16 && counts.dirs == 0;
+
+    // every file is in a subdirectory of the root (depth 1)
+    memset(&counts, 0, sizeof(counts));
+    counts.file_depth = 1;
+    counts.valid = ZPACK_TRUE;
+    ret = zpack_list_dir(&reader, "/", ZPACK_TRUE, count_dir_entry, &counts);
+    printf("-- Listed %d files and %d directories recursively (error %d)\n", counts.files, counts.dirs, ret);
+    passed = passed && ret == ZPACK_OK && counts.valid && counts.files == LARGE_FILE_COUNT && counts.dirs == 16;
+
+    ret = zpack_list_dir(&reader, "directory_16", ZPACK_FALSE, count_dir_entry, &counts);
+    passed = passed && ret == ZPACK_ERROR_FILE_NOT_FOUND;
+
+    // prefetch everything in the background while the files are being read below, then drop
+    // the first half from the page cache
+    zpack_file_entry** prefetch_entries = (zpack_file_entry**)malloc(sizeof(zpack_file_entry*) * LARGE_FILE_COUNT);
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+        prefetch_entries[i] = reader.file_entries + i;
+    ret = zpack_prefetch(&reader, prefetch_entries, LARGE_FILE_COUNT, ZPACK_TRUE);
+    int evict_ret = zpack_evict(&reader, prefetch_entries, LARGE_FILE_COUNT / 2);
+    printf("-- Prefetched and evicted entries (error %d, %d)\n", ret, evict_ret);
+    passed = passed && ret == ZPACK_OK && evict_ret == ZPACK_OK;
+    free(prefetch_entries);
+
+    // batched reads, in reverse order
+    zpack_read_request* requests = (zpack_read_request*)calloc(LARGE_FILE_COUNT, sizeof(zpack_read_request));
+    requests_base = requests;
+    char (*contents)[64] = calloc(LARGE_FILE_COUNT, sizeof(*contents));
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+    {
+        requests[i].entry = reader.file_entries + (LARGE_FILE_COUNT - 1 - i);
+        requests[i].buffer = (zpack_u8*)contents[LARGE_FILE_COUNT - 1 - i];
+        requests[i].max_size = sizeof(*contents) - 1;
+    }
+    ret = zpack_read_files(&reader, requests, LARGE_FILE_COUNT);
+
+    zpack_u64 read = 0;
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+    {
+        if (strcmp(contents[i], names[i]) == 0) ++read;
+    }
+    printf("-- Read %" PRIu64 "/%d entries in a batch (error %d)\n", read, LARGE_FILE_COUNT, ret);
+    passed = passed && ret == ZPACK_OK && read == LARGE_FILE_COUNT;
+
+    // parallel reads
+    memset(contents, 0, sizeof(*contents) * LARGE_FILE_COUNT);
+    zpack_bool* done = (zpack_bool*)calloc(LARGE_FILE_COUNT, sizeof(zpack_bool));
+    ret = zpack_read_files_parallel(&reader, requests, LARGE_FILE_COUNT, 4, on_file_read, done);
+
+    read = 0;
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+    {
+        if (done[LARGE_FILE_COUNT - 1 - i] && strcmp(contents[i], names[i]) == 0) ++read;
+    }
+    printf("-- Read %" PRIu64 "/%d entries in parallel (error %d)\n", read, LARGE_FILE_COUNT, ret);
+    passed = passed && ret == ZPACK_OK && read == LARGE_FILE_COUNT;
+    free(done);
+    zpack_close_reader(&reader);
+
+    // batched reads with io_uring (regular reads if it's not available)
+    reader.flags = ZPACK_READER_ASYNC_IO;
+    if ((ret = zpack_init_reader(&reader, LARGE_ARCHIVE_NAME)))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        free(contents);
+        free(requests);
+        free(names);
+        return 1;
+    }
+    memset(contents, 0, sizeof(*contents) * LARGE_FILE_COUNT);
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+        requests[i].entry = reader.file_entries + (LARGE_FILE_COUNT - 1 - i);
+    ret = zpack_read_files(&reader, requests, LARGE_FILE_COUNT);
+
+    read = 0;
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+    {
+        if (strcmp(contents[i], names[i]) == 0) ++read;
+    }
+    printf("-- Read %" PRIu64 "/%d entries in a batch with %s (error %d)\n", read, LARGE_FILE_COUNT,
+           reader.async_io ? "io_uring" : "regular reads", ret);
+    passed = passed && ret == ZPACK_OK && read == LARGE_FILE_COUNT;
+    zpack_close_reader(&reader);
+
+    // a clone of a mapped reader keeps the mapping alive after the source is closed
+    if ((ret = zpack_init_reader_mmap(&reader, LARGE_ARCHIVE_NAME)) ||
+        (ret = zpack_clone_reader(&clones[0], &reader, NULL)))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        free(contents);
+        free(requests);
+        free(names);
+        return 1;
+    }
+    zpack_close_reader(&reader);
+
+    memset(contents, 0, sizeof(*contents) * LARGE_FILE_COUNT);
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+        requests[i].entry = clones[0].file_entries + (LARGE_FILE_COUNT - 1 - i);
+    ret = zpack_read_files(&clones[0], requests, LARGE_FILE_COUNT);
+
+    read = 0;
+    for (int i = 0; i < LARGE_FILE_COUNT; ++i)
+    {
+        if (strcmp(contents[i], names[i]) == 0) ++read;
+    }
+    printf("-- Read %" PRIu64 "/%d entries with a clone of a mapped reader (error %d)\n", read, LARGE_FILE_COUNT, ret);
+    passed = passed && ret == ZPACK_OK && read == LARGE_FILE_COUNT;
+    free(contents);
+    free(requests);
+    zpack_close_reader(&clones[0]);
+
+    free(names);
+    return !passed;
 }
 
 int main(int argc, char** argv)
@@ -104,5 +717,8 @@ int main(int argc, char** argv)
             return ret;
     }
 
-    return 0;
+    if ((ret = open_nested_archive()))
+        return ret;
+
+    return open_large_archive();
 }
\ No newline at end of file
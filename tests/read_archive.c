@@ -1,16 +1,101 @@
 #include <zpack.h>
 #include <string.h>
+#include <stdlib.h>
 #include "archive.h"
 
 #ifdef _WIN32
 #define PRId64 "lld"
+#include <windows.h>
 #else
 #include <inttypes.h>
+#include <pthread.h>
 #endif
 
 #define BUFFER_SIZE 350
 #define STREAM_IN_SIZE 16
 #define STREAM_OUT_SIZE BUFFER_SIZE
+#define THREAD_COUNT 4
+#define THREAD_PASSES 16
+
+typedef struct sink_output_s
+{
+    zpack_u8* buffer;
+    size_t size;
+    size_t calls;
+    int stop; // returned right away if not 0
+
+} sink_output;
+
+static int write_to_sink_output(const zpack_u8* data, size_t size, void* user_data)
+{
+    sink_output* output = (sink_output*)user_data;
+    if (output->stop) return output->stop;
+    if (size > BUFFER_SIZE - output->size) return ZPACK_ERROR_BUFFER_TOO_SMALL;
+
+    memcpy(output->buffer + output->size, data, size);
+    output->size += size;
+    ++output->calls;
+    return ZPACK_OK;
+}
+
+// stand-in for remote storage
+typedef struct fetch_source_s
+{
+    const zpack_u8* archive;
+    size_t size;
+    size_t calls;
+    zpack_bool count_calls; // off while the reader is used from multiple threads
+
+} fetch_source;
+
+static int fetch_from_source(zpack_u64 offset, zpack_u8* buffer, size_t size, void* user_data)
+{
+    fetch_source* source = (fetch_source*)user_data;
+    if (offset > source->size || size > source->size - offset) return ZPACK_ERROR_READ_FAILED;
+
+    memcpy(buffer, source->archive + offset, size);
+    if (source->count_calls) ++source->calls;
+    return ZPACK_OK;
+}
+
+typedef struct concurrent_reads_s
+{
+    zpack_reader* reader;
+    zpack_bool passed;
+
+} concurrent_reads;
+
+static void read_concurrently(concurrent_reads* reads)
+{
+    zpack_reader* reader = reads->reader;
+    zpack_u8 buffer[BUFFER_SIZE];
+
+    reads->passed = ZPACK_TRUE;
+    for (int pass = 0; pass < THREAD_PASSES; ++pass)
+    {
+        for (int i = 0; i < reader->file_count; ++i)
+        {
+            if (zpack_read_file(reader, reader->file_entries + i, buffer, BUFFER_SIZE, NULL) ||
+                memcmp(buffer, _files[i], _uncomp_sizes[i]) != 0)
+                reads->passed = ZPACK_FALSE;
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI read_concurrently_main(LPVOID arg)
+{
+    read_concurrently((concurrent_reads*)arg);
+    return 0;
+}
+#else
+static void* read_concurrently_main(void* arg)
+{
+    read_concurrently((concurrent_reads*)arg);
+    return NULL;
+}
+#endif
+
 zpack_bool read_and_verify_files(zpack_reader* reader, zpack_u8* buffer)
 {
     zpack_bool passed = ZPACK_TRUE;
@@ -34,6 +119,120 @@ zpack_bool read_and_verify_files(zpack_reader* reader, zpack_u8* buffer)
         memset(buffer, 0, BUFFER_SIZE);
     }
 
+    // Oneshot reads without a context borrow one from the pool and return it afterwards
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        void* volatile* pool = NULL;
+        if (reader->file_entries[i].comp_method == ZPACK_COMPRESSION_ZSTD) pool = reader->zstd_dctx_pool;
+        else if (reader->file_entries[i].comp_method == ZPACK_COMPRESSION_LZ4) pool = reader->lz4f_dctx_pool;
+
+        if (pool && (pool[0] == NULL || pool[1] != NULL))
+        {
+            printf("-- Decompression context of %s was not returned to the pool\n", reader->file_entries[i].filename);
+            passed = ZPACK_FALSE;
+        }
+    }
+
+    // Oneshot decompression with a caller-supplied scratch buffer
+    printf("* Oneshot (scratch)\n");
+    zpack_scratch scratch;
+    memset(&scratch, 0, sizeof(scratch));
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        if ((ret = zpack_read_file_scratch(reader, reader->file_entries + i, buffer, BUFFER_SIZE, NULL, &scratch)))
+        {
+            printf("Failed to read %s (error %d)\n", reader->file_entries[i].filename, ret);
+            passed = ZPACK_FALSE;
+            continue;
+        }
+
+        zpack_bool valid = memcmp(buffer, _files[i], _uncomp_sizes[i]) == 0;
+        passed = passed ? valid : ZPACK_FALSE;
+        printf("-- %s is %s\n", reader->file_entries[i].filename, valid ? "valid" : "invalid");
+
+        memset(buffer, 0, BUFFER_SIZE);
+    }
+    zpack_free_scratch(&scratch);
+
+    // Oneshot decompression into a buffer with room for the compressed data, the scratch buffer is left unused
+    printf("* Oneshot (in place)\n");
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        size_t in_place_size = zpack_get_in_place_size(reader->file_entries + i);
+        if (!in_place_size) continue;
+
+        zpack_u8* in_place_buffer = (zpack_u8*)malloc(in_place_size);
+        ret = in_place_buffer ? zpack_read_file_scratch(reader, reader->file_entries + i, in_place_buffer, in_place_size,
+                                                        NULL, &scratch)
+                              : ZPACK_ERROR_MALLOC_FAILED;
+
+        zpack_bool valid = !ret && scratch.buffer == NULL && memcmp(in_place_buffer, _files[i], _uncomp_sizes[i]) == 0;
+        passed = passed ? valid : ZPACK_FALSE;
+        printf("-- %s is %s (error %d)\n", reader->file_entries[i].filename, valid ? "valid" : "invalid", ret);
+
+        free(in_place_buffer);
+    }
+    zpack_free_scratch(&scratch);
+
+    // Batched decompression (requested in reverse order)
+    printf("* Batch\n");
+    zpack_read_request* requests = (zpack_read_request*)calloc(reader->file_count, sizeof(zpack_read_request));
+    zpack_u8* batch_buffer = (zpack_u8*)calloc(reader->file_count, BUFFER_SIZE);
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        zpack_read_request* request = requests + (reader->file_count - 1 - i);
+        request->entry = reader->file_entries + i;
+        request->buffer = batch_buffer + i * BUFFER_SIZE;
+        request->max_size = BUFFER_SIZE;
+    }
+    if ((ret = zpack_read_files(reader, requests, reader->file_count)))
+    {
+        printf("Failed to read files (error %d)\n", ret);
+        passed = ZPACK_FALSE;
+    }
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        zpack_bool valid = requests[reader->file_count - 1 - i].result == ZPACK_OK &&
+                           memcmp(batch_buffer + i * BUFFER_SIZE, _files[i], _uncomp_sizes[i]) == 0;
+        passed = passed ? valid : ZPACK_FALSE;
+        printf("-- %s is %s\n", reader->file_entries[i].filename, valid ? "valid" : "invalid");
+    }
+
+    // Parallel decompression
+    printf("* Parallel\n");
+    memset(batch_buffer, 0, reader->file_count * BUFFER_SIZE);
+    if ((ret = zpack_read_files_parallel(reader, requests, reader->file_count, 2, NULL, NULL)))
+    {
+        printf("Failed to read files (error %d)\n", ret);
+        passed = ZPACK_FALSE;
+    }
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        zpack_bool valid = requests[reader->file_count - 1 - i].result == ZPACK_OK &&
+                           memcmp(batch_buffer + i * BUFFER_SIZE, _files[i], _uncomp_sizes[i]) == 0;
+        passed = passed ? valid : ZPACK_FALSE;
+        printf("-- %s is %s\n", reader->file_entries[i].filename, valid ? "valid" : "invalid");
+    }
+    free(batch_buffer);
+    free(requests);
+
+    // Zero-copy views (stored files in memory backed readers only)
+    printf("* Views\n");
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        const zpack_u8* data;
+        size_t size;
+        ret = zpack_get_file_view(reader, reader->file_entries + i, &data, &size, ZPACK_TRUE);
+
+        zpack_bool available = reader->buffer && reader->file_entries[i].comp_method == ZPACK_COMPRESSION_NONE;
+        zpack_bool valid = available ?
+            ret == ZPACK_OK && size == _uncomp_sizes[i] && memcmp(data, _files[i], size) == 0 :
+            ret != ZPACK_OK;
+        passed = passed ? valid : ZPACK_FALSE;
+        printf("-- %s is %s\n", reader->file_entries[i].filename,
+               valid ? (available ? "valid" : "not viewable") : "invalid");
+    }
+
     // Streaming decompression
     printf("* Streaming\n");
     zpack_u8 in_buf[STREAM_IN_SIZE];
@@ -81,6 +280,301 @@ zpack_bool read_and_verify_files(zpack_reader* reader, zpack_u8* buffer)
     }
     zpack_close_stream(&stream);
 
+    // Entry stream, with a ring buffer small enough to wrap around
+    printf("* Entry stream\n");
+    zpack_entry_stream entry_stream;
+    memset(&entry_stream, 0, sizeof(zpack_entry_stream));
+    entry_stream.capacity = STREAM_IN_SIZE;
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        ret = zpack_entry_stream_open(&entry_stream, reader, reader->file_entries + i, NULL);
+        size_t total = 0;
+        while (!ret && !entry_stream.done)
+        {
+            size_t read_size;
+            ret = zpack_entry_stream_read(&entry_stream, buffer + total, BUFFER_SIZE - total < 7 ? BUFFER_SIZE - total : 7,
+                                          &read_size);
+            total += read_size;
+        }
+
+        zpack_bool valid = !ret && total == _uncomp_sizes[i] && memcmp(buffer, _files[i], _uncomp_sizes[i]) == 0;
+        passed = passed ? valid : ZPACK_FALSE;
+        printf("-- %s is %s (error %d)\n", reader->file_entries[i].filename, valid ? "valid" : "invalid", ret);
+
+        memset(buffer, 0, BUFFER_SIZE);
+    }
+    zpack_entry_stream_close(&entry_stream);
+
+    // Sink, then a sink that stops before the first chunk
+    printf("* Sink\n");
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        sink_output output = { buffer, 0, 0, 0 };
+        ret = zpack_read_file_to_sink(reader, reader->file_entries + i, write_to_sink_output, &output);
+
+        sink_output stopped_output = { buffer, 0, 0, -1 };
+        int stopped_ret = zpack_read_file_to_sink(reader, reader->file_entries + i, write_to_sink_output, &stopped_output);
+
+        zpack_bool valid = !ret && output.size == _uncomp_sizes[i] && memcmp(buffer, _files[i], _uncomp_sizes[i]) == 0 &&
+                           stopped_ret == -1 && stopped_output.size == 0;
+        passed = passed ? valid : ZPACK_FALSE;
+        printf("-- %s is %s (error %d, %zu chunks)\n", reader->file_entries[i].filename, valid ? "valid" : "invalid", ret,
+               output.calls);
+
+        memset(buffer, 0, BUFFER_SIZE);
+    }
+
+    // One stream per file, read in turns so that they all advance at the same time
+    printf("* Interleaved entry streams\n");
+    zpack_entry_stream entry_streams[FILE_COUNT];
+    size_t totals[FILE_COUNT];
+    memset(entry_streams, 0, sizeof(entry_streams));
+    memset(totals, 0, sizeof(totals));
+
+    zpack_u8* outputs = (zpack_u8*)calloc(FILE_COUNT, BUFFER_SIZE);
+    ret = outputs ? ZPACK_OK : ZPACK_ERROR_MALLOC_FAILED;
+    for (int i = 0; i < reader->file_count && !ret; ++i)
+    {
+        entry_streams[i].capacity = STREAM_IN_SIZE;
+        ret = zpack_entry_stream_open(entry_streams + i, reader, reader->file_entries + i, NULL);
+    }
+
+    zpack_bool reading = !ret;
+    while (reading)
+    {
+        reading = ZPACK_FALSE;
+        for (int i = 0; i < reader->file_count && !ret; ++i)
+        {
+            if (entry_streams[i].done) continue;
+
+            size_t read_size;
+            zpack_u8* output = outputs + (size_t)i * BUFFER_SIZE;
+            ret = zpack_entry_stream_read(entry_streams + i, output + totals[i],
+                                          BUFFER_SIZE - totals[i] < 7 ? BUFFER_SIZE - totals[i] : 7, &read_size);
+            totals[i] += read_size;
+            reading = !ret;
+        }
+    }
+
+    for (int i = 0; i < reader->file_count; ++i)
+    {
+        zpack_bool valid = !ret && totals[i] == _uncomp_sizes[i] &&
+                           memcmp(outputs + (size_t)i * BUFFER_SIZE, _files[i], _uncomp_sizes[i]) == 0;
+        passed = passed ? valid : ZPACK_FALSE;
+        printf("-- %s is %s (error %d)\n", reader->file_entries[i].filename, valid ? "valid" : "invalid", ret);
+
+        zpack_entry_stream_close(entry_streams + i);
+    }
+    free(outputs);
+
+    return passed;
+}
+
+zpack_bool concurrent_read_test(int num)
+{
+    zpack_reader reader;
+    memset(&reader, 0, sizeof(reader));
+
+    int ret;
+    zpack_bool passed = ZPACK_TRUE;
+
+    // read every file from the same reader on several threads at once
+    printf("Concurrent read test\n");
+
+    reader.flags = ZPACK_READER_POSITIONAL_IO;
+    if ((ret = zpack_init_reader(&reader, _archive_names[num])))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        return ZPACK_FALSE;
+    }
+
+    concurrent_reads reads[THREAD_COUNT];
+#ifdef _WIN32
+    HANDLE threads[THREAD_COUNT];
+#else
+    pthread_t threads[THREAD_COUNT];
+#endif
+
+    int started = 0;
+    for (; started < THREAD_COUNT; ++started)
+    {
+        reads[started].reader = &reader;
+        reads[started].passed = ZPACK_FALSE;
+    #ifdef _WIN32
+        threads[started] = CreateThread(NULL, 0, read_concurrently_main, reads + started, 0, NULL);
+        if (!threads[started]) break;
+    #else
+        if (pthread_create(threads + started, NULL, read_concurrently_main, reads + started)) break;
+    #endif
+    }
+
+    for (int i = 0; i < started; ++i)
+    {
+    #ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    #else
+        pthread_join(threads[i], NULL);
+    #endif
+        passed = passed ? reads[i].passed : ZPACK_FALSE;
+    }
+
+    passed = started == THREAD_COUNT && passed;
+    printf("-- %d threads %s\n", started, passed ? "passed" : "failed");
+
+    zpack_close_reader(&reader);
+    return passed;
+}
+
+static zpack_bool is_entry_verified(zpack_reader* reader, int i)
+{
+    return (reader->verified_entries[i / 32] >> (i % 32)) & 1;
+}
+
+zpack_bool verify_policy_test(int num)
+{
+    zpack_reader reader;
+    memset(&reader, 0, sizeof(reader));
+
+    int ret;
+    zpack_bool passed = ZPACK_TRUE;
+    zpack_u8 buffer[BUFFER_SIZE];
+
+    // verify once
+    printf("Verify once test\n");
+
+    reader.verify_policy = ZPACK_VERIFY_ONCE;
+    if ((ret = zpack_init_reader_memory(&reader, _archive_buffers[num], _archive_sizes[num])))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        return ZPACK_FALSE;
+    }
+    passed = read_and_verify_files(&reader, buffer);
+    for (int i = 0; i < reader.file_count; ++i)
+    {
+        zpack_bool verified = is_entry_verified(&reader, i);
+        printf("-- %s is %s\n", reader.file_entries[i].filename, verified ? "verified" : "not verified");
+        passed = passed && verified;
+    }
+    zpack_close_reader(&reader);
+
+    // verify in the background, using a copy of the archive with corrupted file data
+    printf("Background verify test\n");
+
+    zpack_u8* data = (zpack_u8*)malloc(_archive_sizes[num]);
+    memcpy(data, _archive_buffers[num], _archive_sizes[num]);
+
+    reader.verify_policy = ZPACK_VERIFY_BACKGROUND;
+    if ((ret = zpack_init_reader_memory_shared(&reader, data, _archive_sizes[num])))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        free(data);
+        return ZPACK_FALSE;
+    }
+
+    // stored files can be corrupted without breaking decompression
+    zpack_file_entry* corrupted = NULL;
+    if (reader.file_entries[0].comp_method == ZPACK_COMPRESSION_NONE)
+    {
+        corrupted = reader.file_entries;
+        data[corrupted->offset] ^= 0xFF;
+    }
+
+    for (int i = 0; i < reader.file_count; ++i)
+    {
+        if ((ret = zpack_read_file(&reader, reader.file_entries + i, buffer, BUFFER_SIZE, NULL)))
+        {
+            printf("Failed to read %s (error %d)\n", reader.file_entries[i].filename, ret);
+            passed = ZPACK_FALSE;
+        }
+    }
+    zpack_flush_verifier(&reader);
+
+    for (int i = 0; i < reader.file_count; ++i)
+    {
+        zpack_file_entry* entry = reader.file_entries + i;
+        ret = zpack_read_file(&reader, entry, buffer, BUFFER_SIZE, NULL);
+
+        zpack_bool valid = entry == corrupted ?
+            ret == ZPACK_ERROR_FILE_HASH_MISMATCH :
+            ret == ZPACK_OK && is_entry_verified(&reader, i) && memcmp(buffer, _files[i], _uncomp_sizes[i]) == 0;
+        printf("-- %s is %s\n", entry->filename, entry == corrupted ? (valid ? "detected as corrupted" : "not detected as corrupted") :
+                                                                     (valid ? "verified" : "not verified"));
+        passed = passed && valid;
+    }
+    zpack_close_reader(&reader);
+
+    // never verify
+    if (corrupted)
+    {
+        printf("Never verify test\n");
+
+        reader.verify_policy = ZPACK_VERIFY_NEVER;
+        if ((ret = zpack_init_reader_memory_shared(&reader, data, _archive_sizes[num])))
+        {
+            printf("Failed to open archive (error %d)\n", ret);
+            free(data);
+            return ZPACK_FALSE;
+        }
+
+        ret = zpack_read_file(&reader, reader.file_entries, buffer, BUFFER_SIZE, NULL);
+        printf("-- %s is %s\n", reader.file_entries[0].filename, ret == ZPACK_OK ? "not verified" : "verified");
+        passed = passed && ret == ZPACK_OK;
+        zpack_close_reader(&reader);
+    }
+
+    free(data);
+    return passed;
+}
+
+zpack_bool cache_test(int num)
+{
+    printf("Cache test\n");
+
+    zpack_reader reader;
+    memset(&reader, 0, sizeof(reader));
+
+    // only enough room for one of the files
+    reader.cache_budget = _uncomp_sizes[0] > _uncomp_sizes[1] ? _uncomp_sizes[0] : _uncomp_sizes[1];
+
+    int ret;
+    if ((ret = zpack_init_reader_memory(&reader, _archive_buffers[num], _archive_sizes[num])))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        return ZPACK_FALSE;
+    }
+
+    // a second read of the same file shares the buffer
+    const zpack_u8* data1 = NULL;
+    const zpack_u8* data2 = NULL;
+    zpack_bool passed = !zpack_read_file_cached(&reader, reader.file_entries, &data1) &&
+                        !zpack_read_file_cached(&reader, reader.file_entries, &data2) &&
+                        data1 == data2 && memcmp(data1, _files[0], _uncomp_sizes[0]) == 0;
+    printf("-- Cache hit %s\n", passed ? "passed" : "failed");
+
+    // the referenced file goes over the budget instead of being evicted
+    const zpack_u8* data3 = NULL;
+    zpack_bool valid = !zpack_read_file_cached(&reader, reader.file_entries + 1, &data3) &&
+                       memcmp(data1, _files[0], _uncomp_sizes[0]) == 0 &&
+                       memcmp(data3, _files[1], _uncomp_sizes[1]) == 0;
+    printf("-- Referenced files %s\n", valid ? "kept" : "not kept");
+    passed = passed && valid;
+
+    zpack_release_cached_file(&reader, data1);
+    zpack_release_cached_file(&reader, data2);
+    zpack_release_cached_file(&reader, data3);
+
+    // files can be read again after being evicted
+    for (int i = 0; i < reader.file_count; ++i)
+    {
+        valid = !zpack_read_file_cached(&reader, reader.file_entries + i, &data1) &&
+                memcmp(data1, _files[i], _uncomp_sizes[i]) == 0;
+        printf("-- %s is %s\n", reader.file_entries[i].filename, valid ? "valid" : "invalid");
+        passed = passed && valid;
+        zpack_release_cached_file(&reader, data1);
+    }
+    zpack_close_reader(&reader);
+
     return passed;
 }
 
@@ -108,6 +602,19 @@ int read_archive(int num)
     zpack_bool passed1 = read_and_verify_files(&reader, buffer);
     zpack_close_reader(&reader);
 
+    // read from disk using positional I/O
+    printf("Positional read test\n");
+
+    reader.flags = ZPACK_READER_POSITIONAL_IO;
+    if ((ret = zpack_init_reader(&reader, _archive_names[num])))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        return 1;
+    }
+
+    passed1 = read_and_verify_files(&reader, buffer) && passed1;
+    zpack_close_reader(&reader);
+
     // read from buffer
     printf("Buffer read test\n");
 
@@ -121,8 +628,47 @@ int read_archive(int num)
     zpack_bool passed2 = read_and_verify_files(&reader, buffer);
     zpack_close_reader(&reader);
 
+    // read from memory mapped file
+    printf("Mapped read test\n");
+
+    if ((ret = zpack_init_reader_mmap(&reader, _archive_names[num])))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        return 1;
+    }
+
+    zpack_bool passed3 = read_and_verify_files(&reader, buffer);
+    zpack_close_reader(&reader);
+
+    // read through a fetch callback, with a cache small enough to evict blocks and to fetch large reads directly
+    printf("Fetch read test\n");
+
+    fetch_source source = { _archive_buffers[num], _archive_sizes[num], 0, ZPACK_TRUE };
+    reader.fetch_block_size = 64;
+    reader.fetch_cache_size = 256;
+    if ((ret = zpack_init_reader_fetch(&reader, _archive_sizes[num], fetch_from_source, &source)))
+    {
+        printf("Failed to open archive (error %d)\n", ret);
+        return 1;
+    }
+
+    // the whole archive fits in the tail read, and reading a file again doesn't fetch it again
+    zpack_bool passed4 = source.calls == 1;
+    printf("-- Opened with %zu fetches\n", source.calls);
+
+    zpack_file_entry* entry = reader.file_entries;
+    passed4 = !zpack_read_raw_file(&reader, entry, buffer, BUFFER_SIZE) && passed4;
+    size_t calls = source.calls;
+    passed4 = !zpack_read_raw_file(&reader, entry, buffer, BUFFER_SIZE) && source.calls == calls && passed4;
+    printf("-- Cached read %s\n", passed4 ? "passed" : "failed");
+
+    source.count_calls = ZPACK_FALSE;
+    passed4 = read_and_verify_files(&reader, buffer) && passed4;
+    zpack_close_reader(&reader);
+
     // 0 if passed, 1 if failed
-    return !(passed1 && passed2);
+    return !(passed1 && passed2 && passed3 && passed4 && verify_policy_test(num) && cache_test(num) &&
+             concurrent_read_test(num));
 }
 
 int main(int argc, char** argv)